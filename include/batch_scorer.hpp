@@ -0,0 +1,286 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ir {
+
+/**
+ * @brief Number of doubles every row of a ir::log_prob_table is padded to a
+ * multiple of.
+ *
+ * 8 doubles make up a single AVX-512 register or two AVX2 registers; hence,
+ * every row can be processed with full vector operations and no remainder
+ * loop.
+ */
+constexpr size_t SCORE_ALIGN = 8;
+
+/**
+ * @brief Return the smallest multiple of ir::SCORE_ALIGN that is greater than
+ * or equal to the given number of classes.
+ *
+ * @param n_classes Number of classes.
+ *
+ * @return Row stride of a ir::log_prob_table with n_classes many classes.
+ */
+constexpr size_t score_stride(size_t n_classes) {
+    return (n_classes + SCORE_ALIGN - 1) / SCORE_ALIGN * SCORE_ALIGN;
+}
+
+/**
+ * @brief Number of documents scored together in a single ir::sparse_batch
+ * when predicting many documents.
+ */
+constexpr size_t SCORE_BATCH_SIZE = 256;
+
+/**
+ * @brief Non-owning view of dense log-probability tables of a multinomial
+ * model.
+ *
+ * Both tables are stored in row-major order with stride many doubles per row
+ * where only the first n_classes entries of each row are meaningful. The
+ * remaining padding entries must be zero.
+ */
+struct log_prob_table {
+    /**
+     * @brief Log prior of each class (a single row).
+     */
+    const double* log_prior;
+    /**
+     * @brief Log likelihood of each <row,class> pair.
+     */
+    const double* log_likelihood;
+    /**
+     * @brief Number of classes.
+     */
+    size_t n_classes;
+    /**
+     * @brief Number of doubles in a single row.
+     */
+    size_t stride;
+};
+
+/**
+ * @brief Batch of sparse documents in compressed sparse row (CSR) layout.
+ *
+ * Entries of document i are stored in the half-open range
+ * [offsets[i], offsets[i + 1]) of rows and counts where rows holds the table
+ * row of each entry and counts holds how many times it occurs in the document.
+ */
+struct sparse_batch {
+    /**
+     * @brief Beginning of the entries of each document, followed by the total
+     * number of entries.
+     */
+    std::vector<size_t> offsets = {0};
+    /**
+     * @brief Table row of each entry.
+     */
+    std::vector<std::uint32_t> rows;
+    /**
+     * @brief Count of each entry.
+     */
+    std::vector<double> counts;
+
+    /**
+     * @brief Return the number of documents in the batch.
+     *
+     * @return Number of documents.
+     */
+    size_t size() const { return offsets.size() - 1; }
+
+    /**
+     * @brief Remove all the documents from the batch while keeping the
+     * allocated memory.
+     */
+    void clear() {
+        offsets.resize(1);
+        rows.clear();
+        counts.clear();
+    }
+
+    /**
+     * @brief Close the document whose entries were appended last.
+     */
+    void end_doc() { offsets.push_back(rows.size()); }
+};
+
+/**
+ * @brief Instruction set used by the batch scoring kernels.
+ */
+enum class SimdLevel {
+    /**
+     * @brief Portable scalar kernel.
+     */
+    Scalar,
+    /**
+     * @brief Kernel using 256-bit AVX2 registers.
+     */
+    AVX2,
+    /**
+     * @brief Kernel using 512-bit AVX-512 registers.
+     */
+    AVX512
+};
+
+/**
+ * @brief Return the best instruction set supported by the running CPU.
+ *
+ * @return ir::SimdLevel to use for scoring on this CPU.
+ */
+SimdLevel detect_simd_level();
+
+/**
+ * @brief Convert SimdLevel enum to its string representation.
+ *
+ * @param level ir::SimdLevel enum.
+ *
+ * @return std::string representation of ir::SimdLevel.
+ */
+std::string to_string(SimdLevel level);
+
+/**
+ * @brief Compute the unnormalized log posterior of every class for every
+ * document in the given batch.
+ *
+ * Score of document \f$d\f$ for class \f$c\f$ is computed as
+ *
+ * \f[
+ *     \log{p(c)} + \sum_{r \in d}n_r\log{p(r|c)}
+ * \f]
+ *
+ * where \f$n_r\f$ is the count of row \f$r\f$ in \f$d\f$. Counts are
+ * multiplied into the accumulators of all classes at once using the widest
+ * instruction set reported by ir::detect_simd_level. All kernels perform the
+ * same floating point operations in the same order; hence, their results are
+ * identical.
+ *
+ * @param table Log-probability tables.
+ * @param batch Batch of documents whose rows index into table.
+ * @param scores Output array of batch.size() x table.stride doubles.
+ */
+void score_batch(const log_prob_table& table, const sparse_batch& batch,
+                 double* scores);
+
+/**
+ * @brief Compute the scores as in ir::score_batch using the kernel of the
+ * given instruction set.
+ *
+ * @param table Log-probability tables.
+ * @param batch Batch of documents whose rows index into table.
+ * @param scores Output array of batch.size() x table.stride doubles.
+ * @param level Instruction set to use. Must be supported by the running CPU.
+ */
+void score_batch(const log_prob_table& table, const sparse_batch& batch,
+                 double* scores, SimdLevel level);
+
+/**
+ * @brief Return the index of the class with the maximum score.
+ *
+ * @param scores Scores of each class.
+ * @param n_classes Number of classes.
+ *
+ * @return Index of the first class with the maximum score.
+ */
+inline size_t best_score(const double* scores, size_t n_classes) {
+    return static_cast<size_t>(std::distance(
+        scores, std::max_element(scores, scores + n_classes)));
+}
+
+/**
+ * @brief Normalize the given class scores to log posterior probabilities in
+ * place.
+ *
+ * Log of the normalizing constant is computed using the log-sum-exp trick
+ *
+ * \f[
+ *     \log{\sum_c e^{s_c}} = m + \log{\sum_c e^{s_c - m}}
+ * \f]
+ *
+ * where \f$m\f$ is the maximum score; hence, the very large negative scores
+ * of long documents do not underflow to zero.
+ *
+ * @param scores Scores of each class as computed by ir::score_batch.
+ * @param n_classes Number of classes.
+ */
+void normalize_log_proba(double* scores, size_t n_classes);
+
+/**
+ * @brief Return the indices of the classes with the k largest scores.
+ *
+ * @param scores Scores of each class.
+ * @param n_classes Number of classes.
+ * @param k Number of classes to return. If larger than n_classes, all the
+ * classes are returned.
+ *
+ * @return Indices of the classes in decreasing order of their scores. Classes
+ * with equal scores are ordered by their indices.
+ */
+std::vector<size_t> top_k_scores(const double* scores, size_t n_classes,
+                                 size_t k);
+
+/**
+ * @brief Score the samples in range [beg, end) of the given sample vector in
+ * batches of ir::SCORE_BATCH_SIZE documents and call func(i, scores) with the
+ * scores of each sample i in order.
+ *
+ * @tparam Sample Map type from a word to its count in a document.
+ * @tparam RowFunc Function type mapping a word to its table row.
+ * @tparam Func Function type callable as func(size_t, const double*).
+ *
+ * @param table Log-probability tables.
+ * @param x vector of samples to score.
+ * @param beg Index of the first sample to score.
+ * @param end Index one past the last sample to score.
+ * @param row_of Function returning the table row of a word.
+ * @param func Function receiving the index of a sample and a pointer to its
+ * table.stride many scores. The pointer is valid only during the call.
+ */
+template <typename Sample, typename RowFunc, typename Func>
+void score_samples(const log_prob_table& table, const std::vector<Sample>& x,
+                   size_t beg, size_t end, RowFunc row_of, Func func) {
+    sparse_batch batch;
+    std::vector<double> scores;
+
+    for (size_t batch_beg = beg; batch_beg < end;
+         batch_beg += SCORE_BATCH_SIZE) {
+        const size_t batch_end = std::min(batch_beg + SCORE_BATCH_SIZE, end);
+
+        // gather the rows and counts of each sample in the batch
+        batch.clear();
+        for (size_t i = batch_beg; i < batch_end; ++i) {
+            for (const auto& sample_pair : x[i]) {
+                batch.rows.push_back(row_of(sample_pair.first));
+                batch.counts.push_back(sample_pair.second);
+            }
+            batch.end_doc();
+        }
+
+        // score all classes of all samples in the batch at once
+        scores.resize(batch.size() * table.stride);
+        score_batch(table, batch, scores.data());
+
+        for (size_t i = batch_beg; i < batch_end; ++i) {
+            func(i, scores.data() + (i - batch_beg) * table.stride);
+        }
+    }
+}
+} // namespace ir
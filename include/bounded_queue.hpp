@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace ir {
+
+/****************************** INTERFACE **********************************/
+
+/**
+ * @brief Blocking first-in first-out queue holding at most a fixed number of
+ * elements, used to connect the stages of a producer/consumer pipeline.
+ *
+ * A producer blocks in BoundedQueue::push while the queue is full and a
+ * consumer blocks in BoundedQueue::pop while the queue is empty. Hence, a fast
+ * stage cannot run arbitrarily ahead of a slow one, and the number of elements
+ * in flight stays bounded.
+ *
+ * Closing the queue wakes all the waiting threads: consumers drain the
+ * remaining elements and then stop, while producers stop immediately. This
+ * lets a producer signal the end of its output, and a failing consumer stop
+ * its producers.
+ *
+ * @tparam T Type of the elements.
+ */
+template <typename T> class BoundedQueue {
+  public:
+    /**
+     * @brief Construct an empty BoundedQueue.
+     *
+     * @param capacity Maximum number of elements in the queue; at least 1.
+     */
+    explicit BoundedQueue(size_t capacity);
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Append the given element to the queue, waiting while the queue is
+     * full.
+     *
+     * @param value Element to append.
+     *
+     * @return true if the element is appended; false if the queue is closed.
+     */
+    bool push(T value);
+
+    /**
+     * @brief Remove the first element of the queue, waiting while the queue is
+     * empty.
+     *
+     * @param value Reference to store the removed element.
+     *
+     * @return true if an element is removed; false if the queue is closed and
+     * there are no elements left.
+     */
+    bool pop(T& value);
+
+    /**
+     * @brief Close the queue so that no more elements can be pushed.
+     *
+     * Elements already in the queue can still be popped.
+     */
+    void close();
+
+  private:
+    std::deque<T> m_elements;            // elements in the queue
+    size_t m_capacity;                   // maximum number of elements
+    bool m_closed = false;               // true if the queue is closed
+    std::mutex m_mutex;                  // guards all the members above
+    std::condition_variable m_not_full;  // signals a pop or close
+    std::condition_variable m_not_empty; // signals a push or close
+};
+
+/************************** IMPLEMENTATION ********************************/
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity)
+    : m_capacity(capacity == 0 ? 1 : capacity) {}
+
+template <typename T> bool BoundedQueue<T>::push(T value) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this]() {
+            return m_closed || m_elements.size() < m_capacity;
+        });
+        if (m_closed) {
+            return false;
+        }
+        m_elements.push_back(std::move(value));
+    }
+    m_not_empty.notify_one();
+
+    return true;
+}
+
+template <typename T> bool BoundedQueue<T>::pop(T& value) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock,
+                         [this]() { return m_closed || !m_elements.empty(); });
+        if (m_elements.empty()) {
+            return false;
+        }
+        value = std::move(m_elements.front());
+        m_elements.pop_front();
+    }
+    m_not_full.notify_one();
+
+    return true;
+}
+
+template <typename T> void BoundedQueue<T>::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_not_full.notify_all();
+    m_not_empty.notify_all();
+}
+} // namespace ir
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ir {
+
+/**
+ * @brief Relative path from executable to the directory of the per-file
+ * dataset cache.
+ */
+const std::string DATASET_CACHE_DIR = "dataset_cache";
+
+/**
+ * @brief Version of the cached shards.
+ *
+ * This must be incremented whenever the shard format or the way documents are
+ * parsed, tokenized, normalized or stemmed changes, so that the shards built
+ * by an older version are rebuilt.
+ */
+const std::uint64_t DATASET_CACHE_VERSION = 1;
+
+/**
+ * @brief Cache of the train and test documents constructed from each Reuters
+ * sgm file.
+ *
+ * The entry of a source file consists of a train shard and a test shard in the
+ * text dataset format (see ir::write_dataset) and a metadata file. Metadata
+ * stores the path, size, modification time and FNV-1a content hash of the
+ * source file as it was when the shards were built, together with the number
+ * of documents in each shard, ir::DATASET_CACHE_VERSION and the FNV-1a hash
+ * of the stopword list in ir::STOPWORD_PATH. Entries are named after the hash
+ * of the source path; hence, an entry is found without listing the cache
+ * directory.
+ *
+ * An entry built by another cache version or with another stopword list is
+ * never used, since its documents would be tokenized differently. Otherwise,
+ * an entry is up to date if the source file still has the same size and
+ * modification time. If not, the content of the source file is hashed and
+ * compared, so that touching a file without changing it does not cause a
+ * rebuild.
+ */
+class DatasetCache {
+  public:
+    /**
+     * @brief Open the cache in the given directory, creating the directory if
+     * it does not exist.
+     *
+     * The stopword list in ir::STOPWORD_PATH is hashed once here; entries
+     * built with a different list are rebuilt.
+     *
+     * @param dir Path of the cache directory.
+     *
+     * @throws std::runtime_error if the directory cannot be created.
+     */
+    explicit DatasetCache(const std::string& dir);
+
+    /**
+     * @brief Check whether the entry of the given source file is up to date
+     * and get the number of documents in its shards.
+     *
+     * If the content of the source file is unchanged but its modification
+     * time is not, the metadata is updated with the new modification time.
+     *
+     * @param source_path Path of a Reuters sgm file.
+     * @param n_train Reference to store the number of train documents.
+     * @param n_test Reference to store the number of test documents.
+     *
+     * @return true if the shards of the file can be used as they are; false,
+     * if they must be rebuilt.
+     */
+    bool lookup(const std::string& source_path, size_t& n_train,
+                size_t& n_test);
+
+    /**
+     * @brief Remove the metadata of the entry of the given source file so that
+     * the entry is not used until ir::DatasetCache::store is called.
+     *
+     * This must be called before rewriting the shards of an entry.
+     *
+     * @param source_path Path of a Reuters sgm file.
+     */
+    void invalidate(const std::string& source_path);
+
+    /**
+     * @brief Record that the shards of the given source file are built from
+     * the given content.
+     *
+     * @param source_path Path of a Reuters sgm file.
+     * @param content Content of the file the shards are built from.
+     * @param n_train Number of documents in the train shard.
+     * @param n_test Number of documents in the test shard.
+     *
+     * @throws std::runtime_error if the metadata cannot be written.
+     */
+    void store(const std::string& source_path, std::string_view content,
+               size_t n_train, size_t n_test);
+
+    /**
+     * @brief Return the path of the train shard of the given source file.
+     *
+     * @param source_path Path of a Reuters sgm file.
+     *
+     * @return Path of the train shard.
+     */
+    std::string train_shard(const std::string& source_path) const;
+
+    /**
+     * @brief Return the path of the test shard of the given source file.
+     *
+     * @param source_path Path of a Reuters sgm file.
+     *
+     * @return Path of the test shard.
+     */
+    std::string test_shard(const std::string& source_path) const;
+
+  private:
+    /**
+     * @brief Return the common prefix of the paths of the entry of the given
+     * source file.
+     *
+     * @param source_path Path of a Reuters sgm file.
+     *
+     * @return Path of the entry without an extension.
+     */
+    std::string entry_path(const std::string& source_path) const;
+
+    std::string m_dir;              // cache directory
+    std::uint64_t m_stopwords_hash; // FNV-1a hash of ir::STOPWORD_PATH
+};
+} // namespace ir
@@ -0,0 +1,665 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "defs.hpp"
+#include "mapped_file.hpp"
+#include "vocabulary.hpp"
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ir {
+
+/**
+ * @brief Relative path from executable to the output binary training data.
+ */
+const std::string TRAIN_BINARY_SET_PATH = "train.bin";
+
+/**
+ * @brief Relative path from executable to the output binary test data.
+ */
+const std::string TEST_BINARY_SET_PATH = "test.bin";
+
+/**
+ * @brief Relative path from executable to the output compressed training data.
+ */
+const std::string TRAIN_COMPRESSED_SET_PATH = "train.nbz";
+
+/**
+ * @brief Relative path from executable to the output compressed test data.
+ */
+const std::string TEST_COMPRESSED_SET_PATH = "test.nbz";
+
+/**
+ * @brief Magic bytes at the beginning of every binary dataset file.
+ */
+constexpr char BINARY_DATASET_MAGIC[8] = {'N', 'B', 'D', 'A', 'T', 'A', 0, 0};
+
+/**
+ * @brief Version of the binary dataset format written by
+ * ir::write_binary_dataset.
+ */
+constexpr std::uint32_t BINARY_DATASET_VERSION = 1;
+
+/**
+ * @brief Header at the beginning of a binary dataset file.
+ *
+ * Documents are stored in compressed sparse row (CSR) layout. A binary dataset
+ * file consists of the header followed by the sections below, each of which
+ * starts at the byte offset stored in the header:
+ *
+ * Section        | Contents
+ * -------------- | --------------------------------------------------------
+ * ids            | n_docs uint64 document ids
+ * classes        | n_docs uint32 document classes
+ * doc offsets    | n_docs + 1 uint64 offsets into term ids and counts
+ * term ids       | n_entries uint32 indices into the term dictionary
+ * counts         | n_entries uint32 term counts
+ * string offsets | n_terms + 1 uint64 offsets into string data
+ * string data    | terms of the dictionary concatenated
+ *
+ * Entries of document i are stored between doc offsets i and i + 1, and term
+ * t is stored in string data between string offsets t and t + 1. The
+ * dictionary contains only the terms that occur in the dataset. All numbers
+ * are stored in host byte order.
+ */
+struct binary_dataset_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t n_docs;
+    std::uint64_t n_entries;
+    std::uint64_t n_terms;
+    std::uint64_t ids_offset;
+    std::uint64_t classes_offset;
+    std::uint64_t doc_offsets_offset;
+    std::uint64_t term_ids_offset;
+    std::uint64_t counts_offset;
+    std::uint64_t string_offsets_offset;
+    std::uint64_t string_data_offset;
+    std::uint64_t file_size;
+};
+
+/**
+ * @brief Write a dataset whose terms are identified by their ids to the given
+ * output stream in the binary dataset format.
+ *
+ * The format is described in ir::binary_dataset_header. Documents are written
+ * in the iteration order of term_index, and the terms of each document are
+ * sorted by their dictionary index.
+ *
+ * @param os Output stream opened in binary mode.
+ * @param term_index Mapping from document id to term ids and their counts.
+ * @param class_index Mapping from document id to class of the document.
+ * @param vocab Vocabulary that assigned the term ids in term_index.
+ *
+ * @return Modified output stream.
+ */
+std::ostream& write_binary_dataset(std::ostream& os,
+                                   const id_term_index& term_index,
+                                   const doc_class_index& class_index,
+                                   const Vocabulary& vocab);
+
+/**
+ * @brief Check whether the file in the given path is a binary dataset file.
+ *
+ * @param path Path to a dataset file.
+ *
+ * @return true if the file starts with ir::BINARY_DATASET_MAGIC; false,
+ * otherwise.
+ */
+bool is_binary_dataset(const std::string& path);
+
+/**
+ * @brief Magic bytes at the beginning of every compressed dataset file.
+ */
+constexpr char COMPRESSED_DATASET_MAGIC[8] = {'N', 'B', 'D', 'A',
+                                              'T', 'A', 'Z', 0};
+
+/**
+ * @brief Version of the compressed dataset format written by
+ * ir::write_compressed_dataset.
+ */
+constexpr std::uint32_t COMPRESSED_DATASET_VERSION = 1;
+
+/**
+ * @brief Write a dataset whose terms are identified by their ids to the given
+ * output stream in the compressed dataset format.
+ *
+ * A compressed dataset file consists of ir::COMPRESSED_DATASET_MAGIC followed
+ * by a sequence of variable length integers (see ir::append_varint):
+ *
+ * 1. format version,
+ * 2. number of terms in the dictionary followed by the terms sorted and front
+ *    coded (see ir::append_front_coded),
+ * 3. number of documents followed by the documents, each of which is stored
+ *    as its id, class and number of entries followed by the entries sorted by
+ *    their dictionary index. Each entry is stored as the difference of its
+ *    dictionary index from the index of the previous entry in the document and
+ *    its count.
+ *
+ * The dictionary contains only the terms that occur in the dataset. Since
+ * every number is a variable length integer, small counts and index gaps take
+ * a single byte, and the file does not depend on the byte order of the host.
+ * Documents are written in the iteration order of term_index.
+ *
+ * @param os Output stream opened in binary mode.
+ * @param term_index Mapping from document id to term ids and their counts.
+ * @param class_index Mapping from document id to class of the document.
+ * @param vocab Vocabulary that assigned the term ids in term_index.
+ *
+ * @return Modified output stream.
+ */
+std::ostream& write_compressed_dataset(std::ostream& os,
+                                       const id_term_index& term_index,
+                                       const doc_class_index& class_index,
+                                       const Vocabulary& vocab);
+
+/**
+ * @brief Check whether the file in the given path is a compressed dataset
+ * file.
+ *
+ * @param path Path to a dataset file.
+ *
+ * @return true if the file starts with ir::COMPRESSED_DATASET_MAGIC; false,
+ * otherwise.
+ */
+bool is_compressed_dataset(const std::string& path);
+
+/**
+ * @brief Relative path from executable to the output manifest of the sharded
+ * training data.
+ */
+const std::string TRAIN_MANIFEST_PATH = "train.manifest";
+
+/**
+ * @brief Relative path from executable to the output manifest of the sharded
+ * test data.
+ */
+const std::string TEST_MANIFEST_PATH = "test.manifest";
+
+/**
+ * @brief First word of every shard manifest file.
+ */
+const std::string MANIFEST_MAGIC = "NBSHARDS";
+
+/**
+ * @brief Version of the shard manifest format written by ir::write_manifest.
+ */
+constexpr std::uint32_t MANIFEST_VERSION = 1;
+
+/**
+ * @brief List of the shards a dataset is partitioned into.
+ */
+struct shard_manifest {
+    /**
+     * @brief Path of each shard. Relative paths are relative to the directory
+     * of the manifest file.
+     */
+    std::vector<std::string> paths;
+    /**
+     * @brief Number of documents in each shard.
+     */
+    std::vector<size_t> n_docs;
+};
+
+/**
+ * @brief Return the shard a document belongs to when a dataset is partitioned
+ * into the given number of shards.
+ *
+ * Documents are partitioned by the ir::fnv1a_hash of their ids; hence, the
+ * shard of a document does not depend on the platform, the order of the
+ * documents or the other documents in the dataset.
+ *
+ * @param doc_id Id of the document.
+ * @param n_shards Number of shards. Must be positive.
+ *
+ * @return Index of the shard in range [0, n_shards).
+ */
+size_t shard_of(size_t doc_id, size_t n_shards);
+
+/**
+ * @brief Return the path of a shard of the dataset in the given path.
+ *
+ * Index of the shard is inserted before the extension of the dataset path,
+ * e.g. shard 3 of train.txt is train.3.txt.
+ *
+ * @param dataset_path Path of the unsharded dataset.
+ * @param shard Index of the shard.
+ *
+ * @return Path of the shard.
+ */
+std::string shard_path(const std::string& dataset_path, size_t shard);
+
+/**
+ * @brief Write the given manifest to the given output stream.
+ *
+ * A manifest file is a text file whose first line is ir::MANIFEST_MAGIC
+ * followed by ir::MANIFEST_VERSION, and whose second line is the number of
+ * shards. Each following line contains the number of documents in a shard
+ * followed by a space and the path of the shard.
+ *
+ * @param os Output stream.
+ * @param manifest Manifest to write.
+ *
+ * @return Modified output stream.
+ */
+std::ostream& write_manifest(std::ostream& os, const shard_manifest& manifest);
+
+/**
+ * @brief Read the manifest file in the given path.
+ *
+ * Relative shard paths are resolved against the directory of the manifest so
+ * that the returned paths can be opened directly.
+ *
+ * @param path Path to a manifest file.
+ *
+ * @return Read manifest.
+ *
+ * @throws std::runtime_error if the manifest cannot be opened or is
+ * malformed.
+ */
+shard_manifest read_manifest(const std::string& path);
+
+/**
+ * @brief Check whether the file in the given path is a shard manifest file.
+ *
+ * @param path Path to a dataset or manifest file.
+ *
+ * @return true if the file starts with ir::MANIFEST_MAGIC; false, otherwise.
+ */
+bool is_manifest(const std::string& path);
+
+/**
+ * @brief Return the paths of the dataset files in the given path.
+ *
+ * @param path Path to a dataset file in any format or a manifest file.
+ *
+ * @return Paths of the shards if path is a manifest; path itself, otherwise.
+ */
+std::vector<std::string> dataset_paths(const std::string& path);
+
+/**
+ * @brief Read-only view of a memory mapped binary dataset file.
+ *
+ * Documents are accessed directly in the mapped file, and accessing them
+ * requires no parsing or memory allocation. Opening a dataset validates its
+ * header, the bounds of its sections, its offsets and its term ids once;
+ * hence, a truncated or corrupt file is rejected instead of being read out of
+ * bounds.
+ */
+class DatasetFile {
+  public:
+    /**
+     * @brief Map the binary dataset file in the given path.
+     *
+     * @param path Path to a file written by ir::write_binary_dataset.
+     *
+     * @throws std::runtime_error if the file cannot be mapped or is not a
+     * valid binary dataset file.
+     */
+    explicit DatasetFile(const std::string& path);
+
+    /**
+     * @brief Return the number of documents.
+     *
+     * @return Number of documents.
+     */
+    size_t n_docs() const;
+
+    /**
+     * @brief Return the number of terms in the dictionary of the dataset.
+     *
+     * @return Number of terms.
+     */
+    size_t n_terms() const;
+
+    /**
+     * @brief Return the id of the document at the given index.
+     *
+     * @param doc Index of the document.
+     *
+     * @return Document id.
+     */
+    size_t id(size_t doc) const;
+
+    /**
+     * @brief Return the class of the document at the given index.
+     *
+     * @param doc Index of the document.
+     *
+     * @return Document class.
+     */
+    DocClass doc_class(size_t doc) const;
+
+    /**
+     * @brief Return the index of the first entry of the document at the given
+     * index.
+     *
+     * @param doc Index of the document.
+     *
+     * @return Index of the first entry in ir::DatasetFile::term_ids and
+     * ir::DatasetFile::counts.
+     */
+    size_t doc_begin(size_t doc) const;
+
+    /**
+     * @brief Return the index one past the last entry of the document at the
+     * given index.
+     *
+     * @param doc Index of the document.
+     *
+     * @return Index one past the last entry.
+     */
+    size_t doc_end(size_t doc) const;
+
+    /**
+     * @brief Get the dictionary index of the term of every entry.
+     *
+     * @return Pointer to the term ids of all the entries.
+     */
+    const std::uint32_t* term_ids() const;
+
+    /**
+     * @brief Get the count of every entry.
+     *
+     * @return Pointer to the counts of all the entries.
+     */
+    const std::uint32_t* counts() const;
+
+    /**
+     * @brief Return a copy of the term at the given dictionary index.
+     *
+     * @param term Dictionary index of the term.
+     *
+     * @return Term string.
+     */
+    std::string term(size_t term) const;
+
+  private:
+    /**
+     * @brief Return a pointer to the section at the given byte offset.
+     *
+     * @tparam T Type of the elements of the section.
+     *
+     * @param offset Byte offset of the section.
+     *
+     * @return Pointer to the first element of the section.
+     */
+    template <typename T> const T* section(std::uint64_t offset) const;
+
+    MappedFile m_file;                     // mapped dataset file
+    const binary_dataset_header* m_header; // header at the beginning of file
+    const std::uint64_t* m_ids;            // document ids
+    const std::uint32_t* m_classes;        // document classes
+    const std::uint64_t* m_doc_offsets;    // document offsets
+    const std::uint32_t* m_term_ids;       // term of each entry
+    const std::uint32_t* m_counts;         // count of each entry
+    const std::uint64_t* m_str_offsets;    // string offsets
+    const char* m_str_data;                // string data
+};
+
+/**
+ * @brief Read all the documents of the given binary dataset file and intern
+ * their terms to the given vocabulary.
+ *
+ * Each term in the dictionary of the dataset is interned only once.
+ *
+ * @param dataset Mapped binary dataset file.
+ * @param vocab Vocabulary to intern the terms of the dataset.
+ *
+ * @return pair of ir::id_term_index and ir::doc_class_index.
+ */
+std::pair<id_term_index, doc_class_index>
+read_dataset(const DatasetFile& dataset, Vocabulary& vocab);
+
+/**
+ * @brief Read the dataset in the given path and intern its terms to the given
+ * vocabulary.
+ *
+ * The format of the dataset (binary, compressed or text) is detected
+ * automatically.
+ *
+ * @param path Path to a dataset file.
+ * @param vocab Vocabulary to intern the terms of the dataset.
+ *
+ * @return pair of ir::id_term_index and ir::doc_class_index.
+ */
+std::pair<id_term_index, doc_class_index>
+load_dataset(const std::string& path, Vocabulary& vocab);
+
+/**
+ * @brief A single document of a dataset.
+ */
+struct dataset_doc {
+    /**
+     * @brief Id of the document.
+     */
+    size_t id;
+    /**
+     * @brief Class of the document.
+     */
+    DocClass doc_class;
+    /**
+     * @brief Term ids of the document and their counts.
+     */
+    id_sample terms;
+};
+
+/**
+ * @brief A batch of consecutive documents of a dataset stored as parallel
+ * vectors of ids, samples and classes.
+ */
+struct dataset_batch {
+    /**
+     * @brief Id of each document.
+     */
+    std::vector<size_t> ids;
+    /**
+     * @brief Sample of each document, as expected by the classifiers.
+     */
+    std::vector<id_sample> x;
+    /**
+     * @brief Class of each document.
+     */
+    std::vector<DocClass> y;
+
+    /**
+     * @brief Return the number of documents in the batch.
+     *
+     * @return Number of documents.
+     */
+    size_t size() const { return ids.size(); }
+};
+
+/**
+ * @brief Sequential reader yielding the documents of a dataset one at a time
+ * or in fixed-size batches.
+ *
+ * Documents are read directly from the dataset file as they are requested;
+ * hence, memory usage is bounded by the number of documents requested at once
+ * instead of the size of the dataset. Text, binary and compressed datasets are
+ * supported, and the format is detected automatically.
+ *
+ * Text datasets are memory mapped as well and scanned line by line with
+ * memchr. Terms are looked up in the vocabulary as views into the mapped file,
+ * and numbers are parsed in place; hence, no string is constructed except for
+ * the terms seen for the first time.
+ *
+ * Compressed datasets are memory mapped, too, and their documents are decoded
+ * one at a time as they are requested.
+ *
+ * A reader can also be iterated in a range-based for loop:
+ *
+ * @code
+ * for (const ir::dataset_doc& doc : reader) { ... }
+ * @endcode
+ */
+class DatasetReader {
+  public:
+    /**
+     * @brief Input iterator over the remaining documents of a DatasetReader.
+     *
+     * All the iterators of a reader share its position; hence, a dataset can
+     * be iterated only once.
+     */
+    class iterator {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = dataset_doc;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const dataset_doc*;
+        using reference = const dataset_doc&;
+
+        /**
+         * @brief Construct an iterator reading the next document of the given
+         * reader, or the end iterator if reader is nullptr.
+         *
+         * @param reader DatasetReader to read the documents from.
+         */
+        explicit iterator(DatasetReader* reader = nullptr);
+
+        reference operator*() const { return m_doc; }
+        pointer operator->() const { return &m_doc; }
+
+        /**
+         * @brief Read the next document.
+         *
+         * @return Reference to this iterator which becomes the end iterator if
+         * there are no more documents.
+         */
+        iterator& operator++();
+
+        bool operator==(const iterator& other) const {
+            return m_reader == other.m_reader;
+        }
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+      private:
+        DatasetReader* m_reader; // reader, nullptr at the end
+        dataset_doc m_doc;       // current document
+    };
+
+    /**
+     * @brief Open the dataset in the given path.
+     *
+     * Terms of the documents are interned to the given vocabulary as they are
+     * read. Terms of a binary or compressed dataset are interned at once when
+     * it is opened.
+     *
+     * @param path Path to a text, binary or compressed dataset file.
+     * @param vocab Vocabulary to intern the terms of the dataset. Must outlive
+     * the reader.
+     *
+     * @throws std::runtime_error if the dataset cannot be opened, a text
+     * dataset contains a malformed line or a compressed dataset is corrupt.
+     */
+    DatasetReader(const std::string& path, Vocabulary& vocab);
+
+    /**
+     * @brief Read the next document.
+     *
+     * @param doc Reference to store the read document.
+     *
+     * @return true if a document is read; false, if there are no more
+     * documents.
+     */
+    bool next(dataset_doc& doc);
+
+    /**
+     * @brief Read the next batch of at most batch_size documents.
+     *
+     * Memory held by the previous contents of the batch is reused.
+     *
+     * @param batch_size Maximum number of documents to read.
+     * @param batch Reference to store the read documents.
+     *
+     * @return true if at least one document is read; false, if there are no
+     * more documents.
+     */
+    bool next_batch(size_t batch_size, dataset_batch& batch);
+
+    /**
+     * @brief Return an iterator to the next document.
+     *
+     * @return Iterator reading the remaining documents.
+     */
+    iterator begin();
+
+    /**
+     * @brief Return the end iterator.
+     *
+     * @return Iterator denoting the end of the dataset.
+     */
+    iterator end();
+
+  private:
+    /**
+     * @brief Read the next document into the given references.
+     *
+     * @param id Reference to store the id of the document.
+     * @param doc_class Reference to store the class of the document.
+     * @param terms Reference to store the terms of the document.
+     *
+     * @return true if a document is read; false, otherwise.
+     */
+    bool next(size_t& id, DocClass& doc_class, id_sample& terms);
+
+    /**
+     * @brief Read the next document of the text dataset into the given
+     * references.
+     *
+     * @param id Reference to store the id of the document.
+     * @param doc_class Reference to store the class of the document.
+     * @param terms Reference to store the terms of the document.
+     *
+     * @return true if a document is read; false, otherwise.
+     */
+    bool next_text(size_t& id, DocClass& doc_class, id_sample& terms);
+
+    /**
+     * @brief Decode the next document of the compressed dataset into the given
+     * references.
+     *
+     * @param id Reference to store the id of the document.
+     * @param doc_class Reference to store the class of the document.
+     * @param terms Reference to store the terms of the document.
+     *
+     * @return true if a document is read; false, otherwise.
+     */
+    bool next_compressed(size_t& id, DocClass& doc_class, id_sample& terms);
+
+    std::string m_path;                     // path of the dataset
+    Vocabulary& m_vocab;                    // vocabulary to intern terms
+    std::unique_ptr<MappedFile> m_file;     // text or compressed dataset
+    const char* m_pos = nullptr;            // next line or encoded document
+    const char* m_end = nullptr;            // end of m_file
+    size_t m_line = 0;                      // number of lines read
+    bool m_compressed = false;              // true if m_file is compressed
+    std::uint64_t m_docs_left = 0;          // documents left in m_file
+    std::unique_ptr<DatasetFile> m_dataset; // binary dataset
+    std::vector<term_id> m_term_ids;        // vocabulary id of dataset terms
+    size_t m_doc = 0;                       // next document in binary dataset
+};
+} // namespace ir
@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -81,6 +83,17 @@ using unordered_enum_map = std::unordered_map<Enum, Val, EnumClassHash>;
  */
 std::string to_string(DocClass doc_class);
 
+/**
+ * @brief Convert the string representation of a DocClass to the DocClass
+ * enum.
+ *
+ * @param str String representation as returned by ir::to_string.
+ *
+ * @return ir::DocClass enum; ir::DocClass::Other if str does not represent any
+ * other class.
+ */
+DocClass to_doc_class(std::string_view str);
+
 /**
  * @brief Output operator for ir::DocClass.
  *
@@ -145,4 +158,22 @@ using doc_sample = sample<std::string>;
  * operations, a term may or may not contain punctuation characters.
  */
 using doc_term_index = std::unordered_map<size_t, doc_sample>;
+
+/**
+ * @brief Typedef for the dense integer id of a term as assigned by
+ * ir::Vocabulary.
+ */
+using term_id = std::uint32_t;
+
+/**
+ * @brief Representation of a single document as a classifier sample whose
+ * terms are identified by their ir::term_id.
+ */
+using id_sample = sample<term_id>;
+
+/**
+ * @brief Typedef for an index from the id of a document to its terms and their
+ * counts where each term is identified by its ir::term_id.
+ */
+using id_term_index = std::unordered_map<size_t, id_sample>;
 } // namespace ir
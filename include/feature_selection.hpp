@@ -18,6 +18,7 @@
 
 #include "defs.hpp"
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <set>
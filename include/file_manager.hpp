@@ -17,6 +17,7 @@
 #pragma once
 
 #include "defs.hpp"
+#include "vocabulary.hpp"
 #include <string>
 #include <vector>
 
@@ -86,6 +87,41 @@ std::vector<std::string> get_data_file_list();
 std::ostream& write_dataset(std::ostream& os, const doc_term_index& term_index,
                             const doc_class_index& class_index);
 
+/**
+ * @brief Write a dataset whose terms are identified by their ids to the given
+ * output stream.
+ *
+ * The dataset is written in the same format as in ir::write_dataset where each
+ * term id is replaced with its term in the given vocabulary.
+ *
+ * @param os Output stream object to write the dataset to.
+ * @param term_index Mapping from document id to term ids and their counts.
+ * @param class_index Mapping from document id to class of the document.
+ * @param vocab Vocabulary that assigned the term ids in term_index.
+ *
+ * @return Modified output stream.
+ */
+std::ostream& write_dataset(std::ostream& os, const id_term_index& term_index,
+                            const doc_class_index& class_index,
+                            const Vocabulary& vocab);
+
+/**
+ * @brief Write a single document to the given output stream.
+ *
+ * The document is written in the format specified in ir::write_dataset; hence,
+ * a dataset can be written one document at a time as documents are produced.
+ * The stream is not flushed.
+ *
+ * @param os Output stream object to write the document to.
+ * @param id ID of the document.
+ * @param doc_class Class of the document.
+ * @param doc Words of the document and their counts.
+ *
+ * @return Modified output stream.
+ */
+std::ostream& write_document(std::ostream& os, size_t id, DocClass doc_class,
+                             const doc_sample& doc);
+
 /**
  * @brief Read a dataset from the given input stream.
  *
@@ -98,4 +134,56 @@ std::ostream& write_dataset(std::ostream& os, const doc_term_index& term_index,
  */
 std::pair<ir::doc_term_index, ir::doc_class_index>
 read_dataset(std::istream& is);
+
+/**
+ * @brief Read a dataset from the given input stream and intern its terms to
+ * the given vocabulary.
+ *
+ * The dataset to read must be in the format as specified in ir::write_dataset.
+ *
+ * @param is Input stream from which the dataset will be read.
+ * @param vocab Vocabulary to intern the terms of the dataset.
+ *
+ * @return pair of ir::id_term_index and ir::doc_class_index.
+ */
+std::pair<ir::id_term_index, ir::doc_class_index>
+read_dataset(std::istream& is, Vocabulary& vocab);
+
+/**
+ * @brief Read the next document from the given input stream.
+ *
+ * The document must be in the format as specified in ir::write_dataset. The
+ * stream is read only up to the empty line ending the document; hence, a
+ * dataset can be processed one document at a time as it arrives, e.g. from
+ * STDIN.
+ *
+ * @param is Input stream from which the document will be read.
+ * @param id Reference to store the id of the document.
+ * @param doc_class Reference to store the class of the document.
+ * @param doc Reference to store the words of the document and their counts.
+ *
+ * @return true if a document is read; false, if the stream ends before a
+ * document.
+ */
+bool read_document(std::istream& is, size_t& id, DocClass& doc_class,
+                   doc_sample& doc);
+
+/**
+ * @brief Read the next document from the given input stream and intern its
+ * terms to the given vocabulary.
+ *
+ * The document must be in the format as specified in ir::write_dataset.
+ *
+ * @param is Input stream from which the document will be read.
+ * @param vocab Vocabulary to intern the terms of the document.
+ * @param id Reference to store the id of the document.
+ * @param doc_class Reference to store the class of the document.
+ * @param doc Reference to store the term ids of the document and their
+ * counts.
+ *
+ * @return true if a document is read; false, if the stream ends before a
+ * document.
+ */
+bool read_document(std::istream& is, Vocabulary& vocab, size_t& id,
+                   DocClass& doc_class, id_sample& doc);
 } // namespace ir
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ir {
+
+/**
+ * @brief Value stored in binary files to detect files written on a machine
+ * with a different byte order.
+ */
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The file is mapped when the object is constructed and unmapped when it is
+ * destructed. Contents of the file can then be accessed through
+ * MappedFile::data without reading them into a buffer first.
+ *
+ * UNIX C-API is used to map the files (specifically sys/mman.h).
+ */
+class MappedFile {
+  public:
+    /**
+     * @brief Map the file in the given path.
+     *
+     * @param path Path to the file to map.
+     *
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string& path);
+
+    /**
+     * @brief Unmap the file.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Move constructor taking over the mapping of the other object.
+     *
+     * @param other MappedFile to move from. It is left empty.
+     */
+    MappedFile(MappedFile&& other) noexcept;
+
+    /**
+     * @brief Move assignment taking over the mapping of the other object.
+     *
+     * @param other MappedFile to move from. It is left empty.
+     *
+     * @return Reference to this object.
+     */
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * @brief Return a pointer to the beginning of the mapped file.
+     *
+     * @return Pointer to the first byte of the file; nullptr if it is empty.
+     */
+    const char* data() const;
+
+    /**
+     * @brief Return the size of the mapped file.
+     *
+     * @return Number of bytes in the file.
+     */
+    size_t size() const;
+
+  private:
+    /**
+     * @brief Unmap the current mapping, if any.
+     */
+    void unmap();
+
+    const char* m_data = nullptr; // beginning of the mapping
+    size_t m_size = 0;            // size of the mapping
+};
+} // namespace ir
@@ -0,0 +1,1593 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "batch_scorer.hpp"
+#include "defs.hpp"
+#include "mapped_file.hpp"
+#include "naive_bayes_classifier.hpp"
+#include "thread_pool.hpp"
+#include "util.hpp"
+#include "varint.hpp"
+#include "vocabulary.hpp"
+
+namespace ir {
+
+/****************************** INTERFACE **********************************/
+
+/**
+ * @brief Write a NaiveBayesClassifier whose words are term ids to the given
+ * output stream.
+ *
+ * The model is written in the same text format as the output operator of
+ * NaiveBayesClassifier where each term id is replaced with its term in the
+ * given vocabulary.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param os Output stream.
+ * @param clf NaiveBayesClassifier object to write.
+ * @param vocab Vocabulary that assigned the term ids of clf.
+ *
+ * @return Modified output stream.
+ */
+template <typename Class>
+std::ostream& write_model(std::ostream& os,
+                          const NaiveBayesClassifier<term_id, Class>& clf,
+                          const Vocabulary& vocab);
+
+/**
+ * @brief Read a NaiveBayesClassifier in the text format written by
+ * ir::write_model and intern its words to the given vocabulary.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param is Input stream to read the model from.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ *
+ * @return Modified input stream.
+ */
+template <typename Class>
+std::istream& read_model(std::istream& is,
+                         NaiveBayesClassifier<term_id, Class>& clf,
+                         Vocabulary& vocab);
+
+/**
+ * @brief Parse a NaiveBayesClassifier in the text format written by
+ * ir::write_model from the given text and intern its words to the given
+ * vocabulary.
+ *
+ * The text is scanned once in place. Class names are parsed only in the prior
+ * section; classes in the likelihood section are looked up in the table of
+ * these names. Lines of the likelihood section are parsed in chunks on the
+ * threads of the given pool, and the parsed counts are moved into the
+ * classifier in the order they appear in the text; hence, term ids assigned
+ * by vocab do not depend on the number of threads.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param text Contents of a text model file.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ * @param pool Thread pool to parse the likelihood section on.
+ *
+ * @throws std::runtime_error if a line is not in the text model format.
+ */
+template <typename Class>
+void parse_text_model(std::string_view text,
+                      NaiveBayesClassifier<term_id, Class>& clf,
+                      Vocabulary& vocab, ThreadPool& pool);
+
+/**
+ * @brief Load a NaiveBayesClassifier from the text model file at the given
+ * path and intern its words to the given vocabulary.
+ *
+ * The file is memory mapped and parsed with ir::parse_text_model on the
+ * calling thread.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param path Path of a text model file written by ir::write_model.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ *
+ * @throws std::runtime_error if the file cannot be mapped or a line is not in
+ * the text model format.
+ */
+template <typename Class>
+void load_text_model(const std::string& path,
+                     NaiveBayesClassifier<term_id, Class>& clf,
+                     Vocabulary& vocab);
+
+/**
+ * @brief Load a NaiveBayesClassifier from the text model file at the given
+ * path using the threads of the given pool and intern its words to the given
+ * vocabulary.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param path Path of a text model file written by ir::write_model.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ * @param pool Thread pool to parse the likelihood section on.
+ *
+ * @throws std::runtime_error if the file cannot be mapped or a line is not in
+ * the text model format.
+ */
+template <typename Class>
+void load_text_model(const std::string& path,
+                     NaiveBayesClassifier<term_id, Class>& clf,
+                     Vocabulary& vocab, ThreadPool& pool);
+
+/**
+ * @brief Magic bytes at the beginning of every binary model file.
+ */
+constexpr char BINARY_MODEL_MAGIC[8] = {'N', 'B', 'M', 'O', 'D', 'E', 'L', 0};
+
+/**
+ * @brief Version of the binary model format written by
+ * ir::write_binary_model.
+ */
+constexpr std::uint32_t BINARY_MODEL_VERSION = 1;
+
+/**
+ * @brief Marker of an empty bucket in the hash table of a binary model file.
+ */
+constexpr std::uint32_t EMPTY_BUCKET = 0xFFFFFFFF;
+
+/**
+ * @brief Header at the beginning of a binary model file.
+ *
+ * A binary model file consists of the header followed by the sections below,
+ * each of which starts at the byte offset stored in the header:
+ *
+ * Section        | Contents
+ * -------------- | --------------------------------------------------------
+ * class table    | n_classes many ir::binary_model_class entries
+ * string offsets | n_words + 1 uint64 offsets into string data
+ * string data    | terms of all rows concatenated in lexicographic order
+ * hash table     | n_buckets uint32 rows, probed linearly by ir::fnv1a_hash
+ * counts         | n_words x n_classes uint64 <word,class> counts
+ * log prior      | stride doubles
+ * log likelihood | (n_words + 1) x stride doubles, last row for unseen words
+ *
+ * Term of row r is stored in string data between offsets r and r + 1. Log
+ * tables are stored exactly as in ir::log_prob_table and aligned to 64 bytes;
+ * hence, a mapped model file can be used for prediction without any parsing
+ * or copying. All numbers are stored in host byte order.
+ */
+struct binary_model_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t n_classes;
+    std::uint64_t n_words;
+    std::uint64_t stride;
+    std::uint64_t n_buckets;
+    std::uint64_t class_table_offset;
+    std::uint64_t string_offsets_offset;
+    std::uint64_t string_data_offset;
+    std::uint64_t hash_table_offset;
+    std::uint64_t counts_offset;
+    std::uint64_t log_prior_offset;
+    std::uint64_t log_likelihood_offset;
+    std::uint64_t file_size;
+};
+
+/**
+ * @brief Entry of the class table of a binary model file.
+ */
+struct binary_model_class {
+    /**
+     * @brief Integer value of the class.
+     */
+    std::uint64_t value;
+    /**
+     * @brief Number of documents of the class.
+     */
+    std::uint64_t prior;
+    /**
+     * @brief Total number of terms in documents of the class.
+     */
+    std::uint64_t term_count;
+};
+
+/**
+ * @brief Construct the header of a binary model file and lay out its
+ * sections.
+ *
+ * @param n_classes Number of classes.
+ * @param n_words Number of words in the dictionary.
+ * @param n_chars Total number of characters in the terms of all words.
+ *
+ * @return Header whose counts and section offsets are filled.
+ */
+inline binary_model_header make_binary_model_header(size_t n_classes,
+                                                    size_t n_words,
+                                                    size_t n_chars);
+
+/**
+ * @brief Write a NaiveBayesClassifier whose words are term ids to the given
+ * output stream in the binary model format.
+ *
+ * The format is described in ir::binary_model_header. Classes are stored as
+ * their integer values; hence, Class must be an integer or an enum type.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param os Output stream opened in binary mode.
+ * @param clf NaiveBayesClassifier object to write.
+ * @param vocab Vocabulary that assigned the term ids of clf.
+ *
+ * @return Modified output stream.
+ */
+template <typename Class>
+std::ostream&
+write_binary_model(std::ostream& os,
+                   const NaiveBayesClassifier<term_id, Class>& clf,
+                   const Vocabulary& vocab);
+
+/**
+ * @brief Check whether the file in the given path is a binary model file.
+ *
+ * @param path Path to a model file.
+ *
+ * @return true if the file starts with ir::BINARY_MODEL_MAGIC; false,
+ * otherwise.
+ */
+inline bool is_binary_model(const std::string& path);
+
+/**
+ * @brief Read-only view of a memory mapped binary model file.
+ *
+ * The model is used directly from the mapped file; loading it requires no
+ * parsing, and its tables are never copied into memory. Only the header, the
+ * term offsets and the hash table are validated when the file is mapped.
+ *
+ * @tparam Class Type of classes of the model. Must be an integer or an enum
+ * type.
+ */
+template <typename Class> class ModelFile {
+  public:
+    /**
+     * @brief Map the binary model file in the given path.
+     *
+     * @param path Path to a file written by ir::write_binary_model.
+     *
+     * @throws std::runtime_error if the file cannot be mapped or is not a
+     * valid binary model file.
+     */
+    explicit ModelFile(const std::string& path);
+
+    /**
+     * @brief Return the number of classes.
+     *
+     * @return Number of classes.
+     */
+    size_t n_classes() const;
+
+    /**
+     * @brief Return the number of words in the dictionary.
+     *
+     * @return Number of words, which is also the row of unseen words.
+     */
+    size_t n_words() const;
+
+    /**
+     * @brief Get the classes in the order of the columns of the tables.
+     *
+     * @return const-reference to vector of classes.
+     */
+    const std::vector<Class>& classes() const;
+
+    /**
+     * @brief Return the number of documents of the class at the given index.
+     *
+     * @param cls_index Index of the class in ModelFile::classes.
+     *
+     * @return Prior count of the class.
+     */
+    std::uint64_t prior(size_t cls_index) const;
+
+    /**
+     * @brief Return the count of the word at the given row in documents of the
+     * class at the given index.
+     *
+     * @param row Row of the word.
+     * @param cls_index Index of the class in ModelFile::classes.
+     *
+     * @return Marginal likelihood count of the <word,class> pair.
+     */
+    std::uint64_t count(size_t row, size_t cls_index) const;
+
+    /**
+     * @brief Return a pointer to the term of the given row in the mapped file.
+     *
+     * @param row Row of the word.
+     *
+     * @return Pointer to the first character of the term. Term is not null
+     * terminated.
+     */
+    const char* term_data(size_t row) const;
+
+    /**
+     * @brief Return the length of the term of the given row.
+     *
+     * @param row Row of the word.
+     *
+     * @return Number of characters in the term.
+     */
+    size_t term_size(size_t row) const;
+
+    /**
+     * @brief Return a copy of the term of the given row.
+     *
+     * @param row Row of the word.
+     *
+     * @return Term of the row.
+     */
+    std::string term(size_t row) const;
+
+    /**
+     * @brief Return the row of the given term using the hash table stored in
+     * the file.
+     *
+     * @param term Pointer to the first character of the term.
+     * @param size Number of characters in the term.
+     *
+     * @return Row of the term if it is in the dictionary;
+     * ModelFile::n_words, otherwise.
+     */
+    size_t find(const char* term, size_t size) const;
+
+    /**
+     * @brief Return the row of the given term.
+     *
+     * @param term Term to look up.
+     *
+     * @return Row of the term if it is in the dictionary;
+     * ModelFile::n_words, otherwise.
+     */
+    size_t find(const std::string& term) const;
+
+    /**
+     * @brief Get a view of the log-probability tables in the mapped file.
+     *
+     * @return ir::log_prob_table view valid as long as this object lives.
+     */
+    log_prob_table table() const;
+
+    /**
+     * @brief Return the row of every term of the given vocabulary.
+     *
+     * @param vocab Vocabulary whose terms will be looked up.
+     *
+     * @return vector whose i-th element is the row of the term with id i.
+     */
+    std::vector<std::uint32_t> rows_of(const Vocabulary& vocab) const;
+
+    /**
+     * @brief Predict the classes of all samples in the given sample vector
+     * using the threads of the given pool.
+     *
+     * @param x_pred vector of samples keyed by term ids.
+     * @param rows Row of every term id as returned by ModelFile::rows_of.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return Class of each sample in the given order.
+     */
+    std::vector<Class> predict(const std::vector<id_sample>& x_pred,
+                               const std::vector<std::uint32_t>& rows,
+                               ThreadPool& pool) const;
+
+    /**
+     * @brief Compute the log posterior probability of every class for all
+     * samples in the given sample vector using the threads of the given pool.
+     *
+     * @param x_pred vector of samples keyed by term ids.
+     * @param rows Row of every term id as returned by ModelFile::rows_of.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return Log posterior of each class in ModelFile::classes order for each
+     * sample in the given order.
+     */
+    std::vector<std::vector<double>>
+    predict_log_proba(const std::vector<id_sample>& x_pred,
+                      const std::vector<std::uint32_t>& rows,
+                      ThreadPool& pool) const;
+
+    /**
+     * @brief Compute the posterior probability of every class for all samples
+     * in the given sample vector using the threads of the given pool.
+     *
+     * @param x_pred vector of samples keyed by term ids.
+     * @param rows Row of every term id as returned by ModelFile::rows_of.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return Posterior of each class in ModelFile::classes order for each
+     * sample in the given order.
+     */
+    std::vector<std::vector<double>>
+    predict_proba(const std::vector<id_sample>& x_pred,
+                  const std::vector<std::uint32_t>& rows,
+                  ThreadPool& pool) const;
+
+    /**
+     * @brief Return the k most probable classes of all samples in the given
+     * sample vector together with their posterior probabilities using the
+     * threads of the given pool.
+     *
+     * @param x_pred vector of samples keyed by term ids.
+     * @param rows Row of every term id as returned by ModelFile::rows_of.
+     * @param k Number of classes to return per sample.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return <class,posterior> pairs of each sample in decreasing order of
+     * posteriors, as ordered by ir::top_k_scores.
+     */
+    std::vector<std::vector<std::pair<Class, double>>>
+    predict_top_k(const std::vector<id_sample>& x_pred,
+                  const std::vector<std::uint32_t>& rows, size_t k,
+                  ThreadPool& pool) const;
+
+  private:
+    /**
+     * @brief Return a pointer to the section at the given byte offset.
+     *
+     * @tparam T Type of the elements of the section.
+     *
+     * @param offset Byte offset of the section.
+     *
+     * @return Pointer to the first element of the section.
+     */
+    template <typename T> const T* section(std::uint64_t offset) const;
+
+    MappedFile m_file;                    // mapped model file
+    const binary_model_header* m_header;  // header at the beginning of file
+    const binary_model_class* m_classes;  // class table
+    const std::uint64_t* m_str_offsets;   // string offsets
+    const char* m_str_data;               // string data
+    const std::uint32_t* m_buckets;       // hash table
+    const std::uint64_t* m_counts;        // <word,class> counts
+    std::vector<Class> m_class_vec;       // classes in column order
+};
+
+/**
+ * @brief Call the given function for every distinct term of the given binary
+ * model files in lexicographic order.
+ *
+ * Rows of each model file are sorted by term; hence, the union of their
+ * dictionaries is visited by a k-way merge without constructing it in memory.
+ *
+ * @tparam Class Type of classes of the models.
+ * @tparam Func Function type taking the term as (const char*, size_t) and a
+ * const-reference to a vector of <model index, row> pairs of the model files
+ * that contain the term.
+ *
+ * @param models Mapped binary model files.
+ * @param func Function to call for every distinct term.
+ */
+template <typename Class, typename Func>
+void for_each_merged_row(const std::vector<ModelFile<Class>>& models,
+                         Func func);
+
+/**
+ * @brief Merge the given binary model files and write the resulting model to
+ * the given output stream in the binary model format.
+ *
+ * Prior and likelihood counts of the models are summed as in
+ * ir::NaiveBayesClassifier::merge. The models are merged in a few streaming
+ * passes over their sorted rows; only the hash table of the output is kept in
+ * memory.
+ *
+ * @tparam Class Type of classes of the models.
+ *
+ * @param os Output stream opened in binary mode.
+ * @param models Mapped binary model files to merge.
+ *
+ * @return Modified output stream.
+ */
+template <typename Class>
+std::ostream& merge_binary_models(std::ostream& os,
+                                  const std::vector<ModelFile<Class>>& models);
+
+/**
+ * @brief Construct a NaiveBayesClassifier from the counts of the given binary
+ * model file and intern its words to the given vocabulary.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param model Mapped binary model file.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ */
+template <typename Class>
+void read_binary_model(const ModelFile<Class>& model,
+                       NaiveBayesClassifier<term_id, Class>& clf,
+                       Vocabulary& vocab);
+
+/**
+ * @brief Magic bytes at the beginning of every compressed model file.
+ */
+constexpr char COMPRESSED_MODEL_MAGIC[8] = {'N', 'B', 'M', 'O',
+                                            'D', 'E', 'L', 'Z'};
+
+/**
+ * @brief Version of the compressed model format written by
+ * ir::write_compressed_model.
+ */
+constexpr std::uint32_t COMPRESSED_MODEL_VERSION = 1;
+
+/**
+ * @brief Write a NaiveBayesClassifier to the given output stream in the
+ * compressed model format.
+ *
+ * A compressed model file consists of ir::COMPRESSED_MODEL_MAGIC followed by
+ * a sequence of variable length integers (see ir::append_varint):
+ *
+ * 1. format version,
+ * 2. number of classes followed by the value and prior count of each class,
+ * 3. number of words followed by the words sorted by their terms. Each word is
+ *    stored as its front coded term (see ir::append_front_coded) and the
+ *    number of classes it occurs in, followed by the nonzero counts of the
+ *    word in the order of the classes. Each count is preceded by the
+ *    difference of its class index from the index of the previous class.
+ *
+ * Unlike the binary model format, log probabilities are not stored; hence,
+ * a compressed model is compiled when it is read.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param os Output stream opened in binary mode.
+ * @param clf NaiveBayesClassifier object to write.
+ * @param vocab Vocabulary that assigned the ids of the words of clf.
+ *
+ * @return Modified output stream.
+ */
+template <typename Class>
+std::ostream&
+write_compressed_model(std::ostream& os,
+                       const NaiveBayesClassifier<term_id, Class>& clf,
+                       const Vocabulary& vocab);
+
+/**
+ * @brief Check whether the file in the given path is a compressed model file.
+ *
+ * @param path Path to a model file.
+ *
+ * @return true if the file starts with ir::COMPRESSED_MODEL_MAGIC; false,
+ * otherwise.
+ */
+inline bool is_compressed_model(const std::string& path);
+
+/**
+ * @brief Decode a NaiveBayesClassifier in the compressed model format written
+ * by ir::write_compressed_model from the given data and intern its words to
+ * the given vocabulary.
+ *
+ * The data is decoded in a single pass, and the counts are moved into the
+ * classifier.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param data Contents of a compressed model file.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ *
+ * @throws std::runtime_error if the data is not a valid compressed model.
+ */
+template <typename Class>
+void parse_compressed_model(std::string_view data,
+                            NaiveBayesClassifier<term_id, Class>& clf,
+                            Vocabulary& vocab);
+
+/**
+ * @brief Load a NaiveBayesClassifier from the compressed model file at the
+ * given path and intern its words to the given vocabulary.
+ *
+ * @tparam Class Type of classes of the classifier.
+ *
+ * @param path Path of a compressed model file.
+ * @param clf NaiveBayesClassifier reference to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ *
+ * @throws std::runtime_error if the file cannot be mapped or is not a valid
+ * compressed model file.
+ */
+template <typename Class>
+void load_compressed_model(const std::string& path,
+                           NaiveBayesClassifier<term_id, Class>& clf,
+                           Vocabulary& vocab);
+
+/************************** IMPLEMENTATION ********************************/
+
+inline binary_model_header make_binary_model_header(size_t n_classes,
+                                                    size_t n_words,
+                                                    size_t n_chars) {
+    size_t n_buckets = 2;
+    while (n_buckets < 2 * n_words) {
+        n_buckets *= 2;
+    }
+
+    binary_model_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BINARY_MODEL_MAGIC, sizeof(header.magic));
+    header.version = BINARY_MODEL_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.n_classes = n_classes;
+    header.n_words = n_words;
+    header.stride = score_stride(n_classes);
+    header.n_buckets = n_buckets;
+
+    // lay out the sections
+    size_t offset = sizeof(header);
+    auto place = [&offset](size_t size, size_t align) {
+        offset = (offset + align - 1) / align * align;
+        const size_t beg = offset;
+        offset += size;
+        return beg;
+    };
+    const size_t row_bytes = header.stride * sizeof(double);
+    header.class_table_offset =
+        place(n_classes * sizeof(binary_model_class), 8);
+    header.string_offsets_offset =
+        place((n_words + 1) * sizeof(std::uint64_t), 8);
+    header.string_data_offset = place(n_chars, 8);
+    header.hash_table_offset = place(n_buckets * sizeof(std::uint32_t), 8);
+    header.counts_offset =
+        place(n_words * n_classes * sizeof(std::uint64_t), 8);
+    header.log_prior_offset = place(row_bytes, 64);
+    header.log_likelihood_offset = place((n_words + 1) * row_bytes, 64);
+    header.file_size = offset;
+
+    return header;
+}
+
+template <typename Class>
+std::ostream& write_model(std::ostream& os,
+                          const NaiveBayesClassifier<term_id, Class>& clf,
+                          const Vocabulary& vocab) {
+    // output class prior counts on separate lines
+    for (const auto& class_pair : clf.prior()) {
+        const auto class_name = class_pair.first;
+        const size_t count = class_pair.second;
+        os << class_name << ' ' << count << '\n';
+    }
+
+    os << '\n';
+
+    // output marginal likelihood of each <word,class> pair on separate line
+    for (const auto& word_pair : clf.likelihood()) {
+        const auto& word = vocab.term(word_pair.first);
+        const auto& class_cond_count = word_pair.second;
+
+        for (const auto& class_pair : class_cond_count) {
+            const auto class_name = class_pair.first;
+            const size_t count = class_pair.second;
+            os << word << ' ' << class_name << ' ' << count << '\n';
+        }
+    }
+
+    os << std::flush;
+    return os;
+}
+
+template <typename Class>
+std::istream& read_model(std::istream& is,
+                         NaiveBayesClassifier<term_id, Class>& clf,
+                         Vocabulary& vocab) {
+    // read the rest of the stream into a single buffer and parse it in place
+    const std::string text((std::istreambuf_iterator<char>(is)),
+                           std::istreambuf_iterator<char>());
+    ThreadPool pool;
+    parse_text_model(text, clf, vocab, pool);
+
+    return is;
+}
+
+template <typename Class>
+void parse_text_model(std::string_view text,
+                      NaiveBayesClassifier<term_id, Class>& clf,
+                      Vocabulary& vocab, ThreadPool& pool) {
+    using classifier_t = NaiveBayesClassifier<term_id, Class>;
+
+    // minimum number of bytes of the likelihood section parsed as one task
+    constexpr size_t min_chunk_size = 1 << 16;
+
+    auto invalid_line = [](std::string_view line) {
+        return std::runtime_error("Invalid model line: " + std::string(line));
+    };
+    // split line into its fields separated by single spaces from the right
+    auto split_fields = [](std::string_view line, std::string_view* fields,
+                           size_t n_fields) {
+        for (size_t i = n_fields - 1; i > 0; --i) {
+            const size_t sep = line.rfind(' ');
+            if (sep == std::string_view::npos) {
+                return false;
+            }
+            fields[i] = line.substr(sep + 1);
+            line = line.substr(0, sep);
+        }
+        fields[0] = line;
+        return true;
+    };
+
+    // read class prior counts and build the table of class names
+    typename classifier_t::prior_t prior;
+    std::vector<std::string_view> class_names;
+    std::vector<Class> class_values;
+    const char* pos = text.data();
+    const char* end = text.data() + text.size();
+    while (pos != end) {
+        const std::string_view line = next_line(pos, end);
+        if (line.empty()) {
+            break;
+        }
+
+        std::string_view fields[2];
+        size_t count;
+        if (!split_fields(line, fields, 2) || !parse_size(fields[1], count)) {
+            throw invalid_line(line);
+        }
+        std::istringstream ss{std::string(fields[0])};
+        Class class_name;
+        if (!(ss >> class_name)) {
+            throw invalid_line(line);
+        }
+
+        prior[class_name] = count;
+        class_names.push_back(fields[0]);
+        class_values.push_back(class_name);
+    }
+
+    // split the likelihood section into chunks of whole lines
+    std::vector<std::string_view> chunks;
+    const size_t chunk_size = std::max<size_t>(
+        min_chunk_size, static_cast<size_t>(end - pos) / (4 * pool.size()));
+    while (pos != end) {
+        const char* chunk_end = end;
+        if (chunk_size < static_cast<size_t>(end - pos)) {
+            chunk_end = static_cast<const char*>(
+                std::memchr(pos + chunk_size, '\n', end - pos - chunk_size));
+            chunk_end = chunk_end == nullptr ? end : chunk_end + 1;
+        }
+        chunks.emplace_back(pos, static_cast<size_t>(chunk_end - pos));
+        pos = chunk_end;
+    }
+
+    // parse the marginal likelihood of each <word,class> pair in the chunks
+    struct likelihood_entry {
+        std::string_view word;
+        Class class_name;
+        size_t count;
+    };
+    std::vector<std::vector<likelihood_entry>> chunk_entries(chunks.size());
+    pool.parallel_for(chunks.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const char* line_pos = chunks[i].data();
+            const char* chunk_end = line_pos + chunks[i].size();
+            while (line_pos != chunk_end) {
+                const std::string_view line = next_line(line_pos, chunk_end);
+                if (line.empty()) {
+                    continue;
+                }
+
+                std::string_view fields[3];
+                likelihood_entry entry;
+                if (!split_fields(line, fields, 3) ||
+                    !parse_size(fields[2], entry.count)) {
+                    throw invalid_line(line);
+                }
+                const auto it = std::find(class_names.begin(),
+                                          class_names.end(), fields[1]);
+                if (it == class_names.end()) {
+                    throw invalid_line(line);
+                }
+                entry.word = fields[0];
+                entry.class_name = class_values[it - class_names.begin()];
+
+                chunk_entries[i].push_back(entry);
+            }
+        }
+    });
+
+    // build the likelihood in text order; consecutive lines of the same word
+    // share a single vocabulary and likelihood lookup
+    typename classifier_t::likelihood_t likelihood;
+    std::string_view last_word;
+    typename classifier_t::likelihood_t::mapped_type* class_counts = nullptr;
+    for (auto& entries : chunk_entries) {
+        for (const auto& entry : entries) {
+            if (class_counts == nullptr || entry.word != last_word) {
+                class_counts = &likelihood[vocab.intern(entry.word)];
+                last_word = entry.word;
+            }
+            (*class_counts)[entry.class_name] = entry.count;
+        }
+        entries = std::vector<likelihood_entry>();
+    }
+
+    // construct the classifier in place from the read counts
+    clf = classifier_t(std::move(prior), std::move(likelihood));
+}
+
+template <typename Class>
+void load_text_model(const std::string& path,
+                     NaiveBayesClassifier<term_id, Class>& clf,
+                     Vocabulary& vocab) {
+    ThreadPool pool;
+    load_text_model(path, clf, vocab, pool);
+}
+
+template <typename Class>
+void load_text_model(const std::string& path,
+                     NaiveBayesClassifier<term_id, Class>& clf,
+                     Vocabulary& vocab, ThreadPool& pool) {
+    const MappedFile file(path);
+    parse_text_model({file.data(), file.size()}, clf, vocab, pool);
+}
+
+template <typename Class>
+std::ostream&
+write_binary_model(std::ostream& os,
+                   const NaiveBayesClassifier<term_id, Class>& clf,
+                   const Vocabulary& vocab) {
+    const auto& classes = clf.classes();
+    const log_prob_table table = clf.table();
+    const size_t n_classes = classes.size();
+
+    // rows of the file are sorted by term
+    std::vector<term_id> words;
+    words.reserve(clf.likelihood().size());
+    for (const auto& pair : clf.likelihood()) {
+        words.push_back(pair.first);
+    }
+    std::sort(words.begin(), words.end(), [&vocab](term_id lhs, term_id rhs) {
+        return vocab.term(lhs) < vocab.term(rhs);
+    });
+    const size_t n_words = words.size();
+
+    // class table and word counts
+    std::vector<binary_model_class> class_table(n_classes);
+    std::vector<std::uint64_t> counts(n_words * n_classes, 0);
+    for (size_t i = 0; i < n_classes; ++i) {
+        class_table[i].value = static_cast<std::uint64_t>(classes[i]);
+        class_table[i].prior = clf.prior().at(classes[i]);
+        class_table[i].term_count = 0;
+    }
+    for (size_t row = 0; row < n_words; ++row) {
+        for (const auto& class_pair : clf.likelihood().at(words[row])) {
+            const auto index = std::distance(
+                classes.begin(),
+                std::find(classes.begin(), classes.end(), class_pair.first));
+            counts[row * n_classes + index] = class_pair.second;
+            class_table[index].term_count += class_pair.second;
+        }
+    }
+
+    // string table and hash table with a load factor of at most 1/2
+    std::vector<std::uint64_t> str_offsets(n_words + 1, 0);
+    for (size_t row = 0; row < n_words; ++row) {
+        str_offsets[row + 1] = str_offsets[row] + vocab.term(words[row]).size();
+    }
+    const binary_model_header header =
+        make_binary_model_header(n_classes, n_words, str_offsets.back());
+    const size_t n_buckets = header.n_buckets;
+    std::vector<std::uint32_t> buckets(n_buckets, EMPTY_BUCKET);
+    for (size_t row = 0; row < n_words; ++row) {
+        const std::string& term = vocab.term(words[row]);
+        size_t bucket = fnv1a_hash(term.data(), term.size()) & (n_buckets - 1);
+        while (buckets[bucket] != EMPTY_BUCKET) {
+            bucket = (bucket + 1) & (n_buckets - 1);
+        }
+        buckets[bucket] = static_cast<std::uint32_t>(row);
+    }
+    const size_t row_bytes = table.stride * sizeof(double);
+
+    // write the sections in order, padding the gaps with zeros
+    size_t written = 0;
+    auto write_at = [&os, &written](size_t beg, const void* data,
+                                    size_t size) {
+        static const char zeros[64] = {};
+        os.write(zeros, static_cast<std::streamsize>(beg - written));
+        os.write(static_cast<const char*>(data),
+                 static_cast<std::streamsize>(size));
+        written = beg + size;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.class_table_offset, class_table.data(),
+             class_table.size() * sizeof(binary_model_class));
+    write_at(header.string_offsets_offset, str_offsets.data(),
+             str_offsets.size() * sizeof(std::uint64_t));
+    for (size_t row = 0; row < n_words; ++row) {
+        const std::string& term = vocab.term(words[row]);
+        write_at(header.string_data_offset + str_offsets[row], term.data(),
+                 term.size());
+    }
+    write_at(header.hash_table_offset, buckets.data(),
+             buckets.size() * sizeof(std::uint32_t));
+    write_at(header.counts_offset, counts.data(),
+             counts.size() * sizeof(std::uint64_t));
+    write_at(header.log_prior_offset, table.log_prior, row_bytes);
+    for (size_t row = 0; row <= n_words; ++row) {
+        // last row of the classifier table is the row of unseen words
+        const size_t clf_row = row < n_words ? clf.row_of(words[row]) : row;
+        write_at(header.log_likelihood_offset + row * row_bytes,
+                 table.log_likelihood + clf_row * table.stride, row_bytes);
+    }
+
+    os << std::flush;
+    return os;
+}
+
+inline bool is_binary_model(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(BINARY_MODEL_MAGIC)] = {};
+    ifs.read(magic, sizeof(magic));
+
+    return ifs.gcount() == sizeof(magic) &&
+           std::memcmp(magic, BINARY_MODEL_MAGIC, sizeof(magic)) == 0;
+}
+
+template <typename Class>
+ModelFile<Class>::ModelFile(const std::string& path) : m_file(path) {
+    const auto invalid = [&path](const std::string& reason) {
+        return std::runtime_error(path + " is not a valid binary model file: " +
+                                  reason);
+    };
+
+    if (m_file.size() < sizeof(binary_model_header)) {
+        throw invalid("file is too small");
+    }
+    m_header = section<binary_model_header>(0);
+    if (std::memcmp(m_header->magic, BINARY_MODEL_MAGIC,
+                    sizeof(BINARY_MODEL_MAGIC)) != 0) {
+        throw invalid("wrong magic bytes");
+    }
+    if (m_header->version != BINARY_MODEL_VERSION) {
+        throw invalid("unsupported version " +
+                      std::to_string(m_header->version));
+    }
+    if (m_header->byte_order != BYTE_ORDER_MARK) {
+        throw invalid("written with a different byte order");
+    }
+    if (m_header->file_size != m_file.size()) {
+        throw invalid("file is truncated");
+    }
+
+    // counts larger than the file cannot be valid; checking them first also
+    // keeps the section sizes below from overflowing
+    const std::uint64_t file_size = m_file.size();
+    const binary_model_header& h = *m_header;
+    if (h.n_classes == 0 || h.n_classes > file_size ||
+        h.n_words >= EMPTY_BUCKET ||
+        h.stride > file_size || h.stride < h.n_classes) {
+        throw invalid("inconsistent header");
+    }
+    // find probes buckets modulo a power of two
+    if (h.n_buckets == 0 || (h.n_buckets & (h.n_buckets - 1)) != 0 ||
+        h.n_buckets <= h.n_words) {
+        throw invalid("invalid number of hash buckets");
+    }
+
+    // a section of count elements of the given size must lie in the file
+    const auto fits = [file_size](std::uint64_t offset, std::uint64_t count,
+                                  std::uint64_t elem_size, std::uint64_t align) {
+        return offset % align == 0 && offset <= file_size &&
+               (elem_size == 0 || count <= (file_size - offset) / elem_size);
+    };
+    if (!fits(h.class_table_offset, h.n_classes,
+              sizeof(binary_model_class), alignof(binary_model_class)) ||
+        !fits(h.string_offsets_offset, h.n_words + 1,
+              sizeof(std::uint64_t), alignof(std::uint64_t)) ||
+        !fits(h.hash_table_offset, h.n_buckets, sizeof(std::uint32_t),
+              alignof(std::uint32_t)) ||
+        !fits(h.counts_offset, h.n_words, h.n_classes * sizeof(std::uint64_t),
+              alignof(std::uint64_t)) ||
+        !fits(h.log_prior_offset, 1, h.stride * sizeof(double),
+              alignof(double)) ||
+        !fits(h.log_likelihood_offset, h.n_words + 1,
+              h.stride * sizeof(double), alignof(double))) {
+        throw invalid("section out of bounds");
+    }
+
+    m_classes = section<binary_model_class>(h.class_table_offset);
+    m_str_offsets = section<std::uint64_t>(h.string_offsets_offset);
+    if (m_str_offsets[0] != 0 ||
+        !fits(h.string_data_offset, m_str_offsets[h.n_words], 1, 1)) {
+        throw invalid("section out of bounds");
+    }
+    m_str_data = section<char>(m_header->string_data_offset);
+    m_buckets = section<std::uint32_t>(m_header->hash_table_offset);
+    m_counts = section<std::uint64_t>(m_header->counts_offset);
+
+    // terms and hash table entries are read without bounds checks; these
+    // sections are small compared to the log tables, so they are scanned once
+    for (size_t row = 0; row < h.n_words; ++row) {
+        if (m_str_offsets[row] > m_str_offsets[row + 1]) {
+            throw invalid("term offsets are not sorted");
+        }
+    }
+    size_t n_used = 0;
+    for (size_t bucket = 0; bucket < h.n_buckets; ++bucket) {
+        if (m_buckets[bucket] == EMPTY_BUCKET) {
+            continue;
+        }
+        if (m_buckets[bucket] >= h.n_words) {
+            throw invalid("hash table refers to a missing term");
+        }
+        ++n_used;
+    }
+    // probing stops only at an empty bucket
+    if (n_used > h.n_words) {
+        throw invalid("hash table has too many entries");
+    }
+
+    for (size_t i = 0; i < n_classes(); ++i) {
+        m_class_vec.push_back(static_cast<Class>(m_classes[i].value));
+    }
+}
+
+template <typename Class> size_t ModelFile<Class>::n_classes() const {
+    return m_header->n_classes;
+}
+
+template <typename Class> size_t ModelFile<Class>::n_words() const {
+    return m_header->n_words;
+}
+
+template <typename Class>
+const std::vector<Class>& ModelFile<Class>::classes() const {
+    return m_class_vec;
+}
+
+template <typename Class>
+std::uint64_t ModelFile<Class>::prior(size_t cls_index) const {
+    return m_classes[cls_index].prior;
+}
+
+template <typename Class>
+std::uint64_t ModelFile<Class>::count(size_t row, size_t cls_index) const {
+    return m_counts[row * n_classes() + cls_index];
+}
+
+template <typename Class>
+const char* ModelFile<Class>::term_data(size_t row) const {
+    return m_str_data + m_str_offsets[row];
+}
+
+template <typename Class>
+size_t ModelFile<Class>::term_size(size_t row) const {
+    return m_str_offsets[row + 1] - m_str_offsets[row];
+}
+
+template <typename Class>
+std::string ModelFile<Class>::term(size_t row) const {
+    return std::string(term_data(row), term_size(row));
+}
+
+template <typename Class>
+size_t ModelFile<Class>::find(const char* term, size_t size) const {
+    const size_t mask = m_header->n_buckets - 1;
+    size_t bucket = fnv1a_hash(term, size) & mask;
+
+    // linear probing until the term or an empty bucket is found
+    while (m_buckets[bucket] != EMPTY_BUCKET) {
+        const size_t row = m_buckets[bucket];
+        if (term_size(row) == size &&
+            std::memcmp(term_data(row), term, size) == 0) {
+            return row;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    return n_words();
+}
+
+template <typename Class>
+size_t ModelFile<Class>::find(const std::string& term) const {
+    return find(term.data(), term.size());
+}
+
+template <typename Class> log_prob_table ModelFile<Class>::table() const {
+    return {section<double>(m_header->log_prior_offset),
+            section<double>(m_header->log_likelihood_offset), n_classes(),
+            m_header->stride};
+}
+
+template <typename Class>
+std::vector<std::uint32_t>
+ModelFile<Class>::rows_of(const Vocabulary& vocab) const {
+    std::vector<std::uint32_t> rows(vocab.size());
+    for (size_t id = 0; id < vocab.size(); ++id) {
+        rows[id] = static_cast<std::uint32_t>(
+            find(vocab.term(static_cast<term_id>(id))));
+    }
+    return rows;
+}
+
+template <typename Class>
+std::vector<Class>
+ModelFile<Class>::predict(const std::vector<id_sample>& x_pred,
+                          const std::vector<std::uint32_t>& rows,
+                          ThreadPool& pool) const {
+    const log_prob_table tables = table();
+
+    std::vector<Class> y_pred(x_pred.size());
+    pool.parallel_for(
+        x_pred.size(), SCORE_BATCH_SIZE, [&](size_t beg, size_t end) {
+            score_samples(
+                tables, x_pred, beg, end,
+                [&rows](term_id id) { return rows[id]; },
+                [&](size_t i, const double* scores) {
+                    y_pred[i] = m_class_vec[best_score(scores, n_classes())];
+                });
+        });
+
+    return y_pred;
+}
+
+template <typename Class>
+std::vector<std::vector<double>>
+ModelFile<Class>::predict_log_proba(const std::vector<id_sample>& x_pred,
+                                    const std::vector<std::uint32_t>& rows,
+                                    ThreadPool& pool) const {
+    const log_prob_table tables = table();
+
+    std::vector<std::vector<double>> log_proba(x_pred.size());
+    pool.parallel_for(
+        x_pred.size(), SCORE_BATCH_SIZE, [&](size_t beg, size_t end) {
+            score_samples(
+                tables, x_pred, beg, end,
+                [&rows](term_id id) { return rows[id]; },
+                [&](size_t i, const double* scores) {
+                    log_proba[i].assign(scores, scores + n_classes());
+                    normalize_log_proba(log_proba[i].data(), n_classes());
+                });
+        });
+
+    return log_proba;
+}
+
+template <typename Class>
+std::vector<std::vector<double>>
+ModelFile<Class>::predict_proba(const std::vector<id_sample>& x_pred,
+                                const std::vector<std::uint32_t>& rows,
+                                ThreadPool& pool) const {
+    auto proba = predict_log_proba(x_pred, rows, pool);
+    for (auto& row : proba) {
+        for (double& value : row) {
+            value = std::exp(value);
+        }
+    }
+
+    return proba;
+}
+
+template <typename Class>
+std::vector<std::vector<std::pair<Class, double>>>
+ModelFile<Class>::predict_top_k(const std::vector<id_sample>& x_pred,
+                                const std::vector<std::uint32_t>& rows,
+                                size_t k, ThreadPool& pool) const {
+    const auto proba = predict_proba(x_pred, rows, pool);
+
+    std::vector<std::vector<std::pair<Class, double>>> top(proba.size());
+    for (size_t i = 0; i < proba.size(); ++i) {
+        const auto& row = proba[i];
+        for (size_t index : top_k_scores(row.data(), row.size(), k)) {
+            top[i].emplace_back(m_class_vec[index], row[index]);
+        }
+    }
+
+    return top;
+}
+
+template <typename Class>
+template <typename T>
+const T* ModelFile<Class>::section(std::uint64_t offset) const {
+    return reinterpret_cast<const T*>(m_file.data() + offset);
+}
+
+template <typename Class, typename Func>
+void for_each_merged_row(const std::vector<ModelFile<Class>>& models,
+                         Func func) {
+    using source = std::pair<size_t, size_t>; // <model index, row>
+
+    // lexicographic order of terms, same as the order of std::string
+    const auto term_less = [&models](const source& lhs, const source& rhs) {
+        const size_t lhs_size = models[lhs.first].term_size(lhs.second);
+        const size_t rhs_size = models[rhs.first].term_size(rhs.second);
+        const int cmp = std::memcmp(models[lhs.first].term_data(lhs.second),
+                                    models[rhs.first].term_data(rhs.second),
+                                    std::min(lhs_size, rhs_size));
+        return cmp < 0 || (cmp == 0 && lhs_size < rhs_size);
+    };
+    const auto heap_cmp = [&term_less](const source& lhs, const source& rhs) {
+        return term_less(rhs, lhs);
+    };
+
+    // min-heap of the current row of every model
+    std::vector<source> heap;
+    for (size_t m = 0; m < models.size(); ++m) {
+        if (models[m].n_words() != 0) {
+            heap.emplace_back(m, 0);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), heap_cmp);
+
+    std::vector<source> sources;
+    while (!heap.empty()) {
+        // pop the rows of every model that stores the smallest term
+        const source top = heap.front();
+        sources.clear();
+        do {
+            std::pop_heap(heap.begin(), heap.end(), heap_cmp);
+            sources.push_back(heap.back());
+            heap.pop_back();
+        } while (!heap.empty() && !term_less(top, heap.front()));
+
+        func(models[top.first].term_data(top.second),
+             models[top.first].term_size(top.second),
+             static_cast<const std::vector<source>&>(sources));
+
+        // advance the popped models to their next rows
+        for (source src : sources) {
+            if (++src.second < models[src.first].n_words()) {
+                heap.push_back(src);
+                std::push_heap(heap.begin(), heap.end(), heap_cmp);
+            }
+        }
+    }
+}
+
+template <typename Class>
+std::ostream& merge_binary_models(std::ostream& os,
+                                  const std::vector<ModelFile<Class>>& models) {
+    using source = std::pair<size_t, size_t>;
+    using clf_t = NaiveBayesClassifier<term_id, Class>;
+
+    // merged classes in the order they are first seen, and the merged column
+    // of each column of each model
+    std::vector<Class> classes;
+    std::vector<std::vector<size_t>> columns(models.size());
+    for (size_t m = 0; m < models.size(); ++m) {
+        for (const Class& cls : models[m].classes()) {
+            const auto it = std::find(classes.begin(), classes.end(), cls);
+            columns[m].push_back(std::distance(classes.begin(), it));
+            if (it == classes.end()) {
+                classes.push_back(cls);
+            }
+        }
+    }
+    const size_t n_classes = classes.size();
+
+    // class table
+    std::vector<binary_model_class> class_table(n_classes);
+    size_t total_samples = 0;
+    for (size_t i = 0; i < n_classes; ++i) {
+        class_table[i].value = static_cast<std::uint64_t>(classes[i]);
+        class_table[i].prior = 0;
+        class_table[i].term_count = 0;
+    }
+    for (size_t m = 0; m < models.size(); ++m) {
+        for (size_t i = 0; i < models[m].n_classes(); ++i) {
+            class_table[columns[m][i]].prior += models[m].prior(i);
+            total_samples += models[m].prior(i);
+        }
+    }
+
+    // merged <word,class> counts of a row
+    std::vector<std::uint64_t> counts(n_classes);
+    const auto merge_counts = [&](const std::vector<source>& sources) {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (const source& src : sources) {
+            const auto& model = models[src.first];
+            for (size_t i = 0; i < model.n_classes(); ++i) {
+                counts[columns[src.first][i]] += model.count(src.second, i);
+            }
+        }
+    };
+
+    // first pass: dictionary size, string table size and class term counts
+    size_t n_words = 0;
+    size_t n_chars = 0;
+    for_each_merged_row(models, [&](const char*, size_t size,
+                                    const std::vector<source>& sources) {
+        ++n_words;
+        n_chars += size;
+        merge_counts(sources);
+        for (size_t i = 0; i < n_classes; ++i) {
+            class_table[i].term_count += counts[i];
+        }
+    });
+
+    const binary_model_header header =
+        make_binary_model_header(n_classes, n_words, n_chars);
+    const size_t n_buckets = header.n_buckets;
+    const size_t stride = header.stride;
+
+    // write the sections in order, padding the gaps with zeros
+    size_t written = 0;
+    auto write_at = [&os, &written](size_t beg, const void* data,
+                                    size_t size) {
+        static const char zeros[64] = {};
+        os.write(zeros, static_cast<std::streamsize>(beg - written));
+        os.write(static_cast<const char*>(data),
+                 static_cast<std::streamsize>(size));
+        written = beg + size;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.class_table_offset, class_table.data(),
+             class_table.size() * sizeof(binary_model_class));
+
+    // string offsets and hash table
+    std::vector<std::uint32_t> buckets(n_buckets, EMPTY_BUCKET);
+    std::uint64_t str_offset = 0;
+    std::uint32_t row = 0;
+    write_at(header.string_offsets_offset, &str_offset, sizeof(str_offset));
+    for_each_merged_row(models, [&](const char* term, size_t size,
+                                    const std::vector<source>&) {
+        str_offset += size;
+        write_at(written, &str_offset, sizeof(str_offset));
+
+        size_t bucket = fnv1a_hash(term, size) & (n_buckets - 1);
+        while (buckets[bucket] != EMPTY_BUCKET) {
+            bucket = (bucket + 1) & (n_buckets - 1);
+        }
+        buckets[bucket] = row++;
+    });
+
+    // string data
+    write_at(header.string_data_offset, nullptr, 0);
+    for_each_merged_row(models, [&](const char* term, size_t size,
+                                    const std::vector<source>&) {
+        write_at(written, term, size);
+    });
+    write_at(header.hash_table_offset, buckets.data(),
+             buckets.size() * sizeof(std::uint32_t));
+
+    // counts
+    write_at(header.counts_offset, nullptr, 0);
+    for_each_merged_row(models, [&](const char*, size_t,
+                                    const std::vector<source>& sources) {
+        merge_counts(sources);
+        write_at(written, counts.data(), n_classes * sizeof(std::uint64_t));
+    });
+
+    // log tables computed exactly as in NaiveBayesClassifier
+    std::vector<double> log_row(stride, 0);
+    for (size_t i = 0; i < n_classes; ++i) {
+        log_row[i] = clf_t::log_prior(class_table[i].prior, total_samples);
+    }
+    write_at(header.log_prior_offset, log_row.data(), stride * sizeof(double));
+
+    const auto write_log_row = [&]() {
+        for (size_t i = 0; i < n_classes; ++i) {
+            log_row[i] = clf_t::log_likelihood(
+                counts[i], class_table[i].term_count, n_words);
+        }
+        write_at(written, log_row.data(), stride * sizeof(double));
+    };
+    write_at(header.log_likelihood_offset, nullptr, 0);
+    for_each_merged_row(models, [&](const char*, size_t,
+                                    const std::vector<source>& sources) {
+        merge_counts(sources);
+        write_log_row();
+    });
+
+    // last row of unseen words
+    std::fill(counts.begin(), counts.end(), 0);
+    write_log_row();
+
+    os << std::flush;
+    return os;
+}
+
+template <typename Class>
+void read_binary_model(const ModelFile<Class>& model,
+                       NaiveBayesClassifier<term_id, Class>& clf,
+                       Vocabulary& vocab) {
+    using classifier_t = NaiveBayesClassifier<term_id, Class>;
+    typename classifier_t::prior_t prior;
+    typename classifier_t::likelihood_t likelihood;
+
+    const auto& classes = model.classes();
+    for (size_t i = 0; i < classes.size(); ++i) {
+        prior[classes[i]] = model.prior(i);
+    }
+
+    likelihood.reserve(model.n_words());
+    for (size_t row = 0; row < model.n_words(); ++row) {
+        auto& class_counts = likelihood[vocab.intern(model.term(row))];
+        for (size_t i = 0; i < classes.size(); ++i) {
+            const std::uint64_t count = model.count(row, i);
+            if (count != 0) {
+                class_counts[classes[i]] = count;
+            }
+        }
+    }
+
+    clf = classifier_t(std::move(prior), std::move(likelihood));
+}
+
+template <typename Class>
+std::ostream&
+write_compressed_model(std::ostream& os,
+                       const NaiveBayesClassifier<term_id, Class>& clf,
+                       const Vocabulary& vocab) {
+    // encoded bytes are written to os whenever the buffer grows this large
+    constexpr size_t buffer_size = 1 << 20;
+    const auto& classes = clf.classes();
+
+    std::string out(COMPRESSED_MODEL_MAGIC, sizeof(COMPRESSED_MODEL_MAGIC));
+    append_varint(out, COMPRESSED_MODEL_VERSION);
+    append_varint(out, classes.size());
+    for (const auto& cls : classes) {
+        append_varint(out, static_cast<std::uint64_t>(cls));
+        append_varint(out, clf.prior().at(cls));
+    }
+
+    // words are sorted by term so that consecutive terms share prefixes
+    std::vector<term_id> words;
+    words.reserve(clf.likelihood().size());
+    for (const auto& pair : clf.likelihood()) {
+        words.push_back(pair.first);
+    }
+    std::sort(words.begin(), words.end(), [&vocab](term_id lhs, term_id rhs) {
+        return vocab.term(lhs) < vocab.term(rhs);
+    });
+
+    append_varint(out, words.size());
+    std::string_view prev;
+    std::vector<std::uint64_t> counts(classes.size());
+    for (const term_id word : words) {
+        const std::string& term = vocab.term(word);
+        append_front_coded(out, prev, term);
+        prev = term;
+
+        std::fill(counts.begin(), counts.end(), 0);
+        size_t n_nonzero = 0;
+        for (const auto& class_pair : clf.likelihood().at(word)) {
+            const auto index = std::distance(
+                classes.begin(),
+                std::find(classes.begin(), classes.end(), class_pair.first));
+            counts[index] = class_pair.second;
+            n_nonzero += class_pair.second != 0;
+        }
+
+        append_varint(out, n_nonzero);
+        size_t prev_index = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (counts[i] != 0) {
+                append_varint(out, i - prev_index);
+                append_varint(out, counts[i]);
+                prev_index = i;
+            }
+        }
+
+        if (out.size() >= buffer_size) {
+            os.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    os.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+    os << std::flush;
+    return os;
+}
+
+inline bool is_compressed_model(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(COMPRESSED_MODEL_MAGIC)] = {};
+    ifs.read(magic, sizeof(magic));
+
+    return ifs.gcount() == sizeof(magic) &&
+           std::memcmp(magic, COMPRESSED_MODEL_MAGIC, sizeof(magic)) == 0;
+}
+
+template <typename Class>
+void parse_compressed_model(std::string_view data,
+                            NaiveBayesClassifier<term_id, Class>& clf,
+                            Vocabulary& vocab) {
+    using classifier_t = NaiveBayesClassifier<term_id, Class>;
+
+    const char* pos = data.data();
+    const char* end = data.data() + data.size();
+    auto read = [&pos, end]() {
+        std::uint64_t value;
+        if (!read_varint(pos, end, value)) {
+            throw std::runtime_error("Invalid compressed model");
+        }
+        return value;
+    };
+    // every counted item takes at least one byte of the remaining data
+    auto read_size = [&pos, end, &read]() {
+        const std::uint64_t size = read();
+        if (size > static_cast<std::uint64_t>(end - pos)) {
+            throw std::runtime_error("Invalid compressed model");
+        }
+        return size;
+    };
+
+    if (data.size() < sizeof(COMPRESSED_MODEL_MAGIC) ||
+        std::memcmp(pos, COMPRESSED_MODEL_MAGIC,
+                    sizeof(COMPRESSED_MODEL_MAGIC)) != 0) {
+        throw std::runtime_error("Invalid compressed model: wrong magic bytes");
+    }
+    pos += sizeof(COMPRESSED_MODEL_MAGIC);
+    const std::uint64_t version = read();
+    if (version != COMPRESSED_MODEL_VERSION) {
+        throw std::runtime_error("Unsupported compressed model version " +
+                                 std::to_string(version));
+    }
+
+    // class values and prior counts
+    typename classifier_t::prior_t prior;
+    std::vector<Class> classes(read_size());
+    for (auto& cls : classes) {
+        cls = static_cast<Class>(read());
+        prior[cls] = read();
+    }
+
+    // words and their nonzero counts
+    typename classifier_t::likelihood_t likelihood;
+    const std::uint64_t n_words = read_size();
+    likelihood.reserve(n_words);
+    std::string term;
+    for (std::uint64_t row = 0; row < n_words; ++row) {
+        if (!read_front_coded(pos, end, term)) {
+            throw std::runtime_error("Invalid compressed model");
+        }
+        auto& class_counts = likelihood[vocab.intern(term)];
+
+        const std::uint64_t n_nonzero = read();
+        std::uint64_t index = 0;
+        for (std::uint64_t i = 0; i < n_nonzero; ++i) {
+            index += read();
+            if (index >= classes.size()) {
+                throw std::runtime_error("Invalid compressed model");
+            }
+            class_counts[classes[index]] = read();
+        }
+    }
+
+    clf = classifier_t(std::move(prior), std::move(likelihood));
+}
+
+template <typename Class>
+void load_compressed_model(const std::string& path,
+                           NaiveBayesClassifier<term_id, Class>& clf,
+                           Vocabulary& vocab) {
+    const MappedFile file(path);
+    parse_compressed_model({file.data(), file.size()}, clf, vocab);
+}
+
+} // namespace ir
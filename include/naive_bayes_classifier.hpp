@@ -17,17 +17,20 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <numeric>
-#include <set>
 #include <sstream>
 #include <vector>
 
+#include "batch_scorer.hpp"
 #include "defs.hpp"
+#include "thread_pool.hpp"
 #include "util.hpp"
 
 namespace ir {
@@ -92,6 +95,19 @@ template <typename Word, typename Class> class NaiveBayesClassifier {
      */
     NaiveBayesClassifier(const prior_t& prior, const likelihood_t& likelihood);
 
+    /**
+     * @brief Constructor that initializes this object by moving the given
+     * prior and likelihood into it.
+     *
+     * This constructor avoids copying the counts when they are built by the
+     * caller only to construct a classifier, e.g. while reading a model.
+     *
+     * @param prior Prior class count distribution.
+     * @param likelihood Marginal likelihood count distribution \f$p(w|c)\f$
+     * where \f$w\f$ is a word and \f$c\f$ is a class.
+     */
+    NaiveBayesClassifier(prior_t&& prior, likelihood_t&& likelihood);
+
     /**
      * @brief Fit this NaiveBayesClassifier with the given training data and
      * labels.
@@ -104,6 +120,67 @@ template <typename Word, typename Class> class NaiveBayesClassifier {
     NaiveBayesClassifier& fit(const std::vector<sample<Word>>& x_train,
                               const std::vector<Class>& y_train);
 
+    /**
+     * @brief Fit this NaiveBayesClassifier with the given training data and
+     * labels using the threads of the given pool.
+     *
+     * Training set is partitioned into one contiguous part per thread. Each
+     * thread accumulates the prior and likelihood counts of its own part
+     * privately, and the partial counts are then merged pairwise in parallel
+     * until a single set of counts remains. The fitted model is the same as
+     * the one fitted by the single threaded version.
+     *
+     * @param x_train vector of document samples NaiveBayesClassifier::sample.
+     * @param y_train vector of classes.
+     * @param pool ThreadPool whose threads will count the samples.
+     *
+     * @return Reference to the fitted version of this object.
+     */
+    NaiveBayesClassifier& fit(const std::vector<sample<Word>>& x_train,
+                              const std::vector<Class>& y_train,
+                              ThreadPool& pool);
+
+    /**
+     * @brief Update this NaiveBayesClassifier with the given additional
+     * training data and labels.
+     *
+     * Since all the parameters of a Multinomial Naive Bayes model are counts,
+     * the result is the same as fitting from scratch on the concatenation of
+     * the previous and the given training sets. Counts and derived fields are
+     * updated in time proportional to the size of the given data, and the
+     * log-probability tables are only marked out of date. Since the size of
+     * the dictionary appears in every smoothed likelihood, the tables are
+     * rebuilt as a whole, but only once, when they are used next (e.g. by
+     * NaiveBayesClassifier::predict or NaiveBayesClassifier::table); hence,
+     * consecutive updates do not pay for rebuilding them.
+     *
+     * @param x_train vector of additional document samples.
+     * @param y_train vector of classes of the additional samples.
+     *
+     * @return Reference to the updated version of this object.
+     */
+    NaiveBayesClassifier& partial_fit(const std::vector<sample<Word>>& x_train,
+                                      const std::vector<Class>& y_train);
+
+    /**
+     * @brief Merge the counts of the given NaiveBayesClassifier into this
+     * one.
+     *
+     * Prior and likelihood counts are summed, and the derived fields are
+     * updated in time proportional to the size of the given classifier. As in
+     * NaiveBayesClassifier::partial_fit, the log-probability tables are
+     * rebuilt only once, when they are used next; hence, merging many
+     * classifiers one after another costs as much as summing their counts.
+     * The result is the same as fitting a single classifier on the training
+     * sets of both classifiers. Words of both classifiers must come from the
+     * same domain (e.g. the same ir::Vocabulary).
+     *
+     * @param other NaiveBayesClassifier to merge into this one.
+     *
+     * @return Reference to the merged version of this object.
+     */
+    NaiveBayesClassifier& merge(const NaiveBayesClassifier& other);
+
     /**
      * @brief Predict the class of a single sample using the already learned
      * parameters.
@@ -117,12 +194,168 @@ template <typename Word, typename Class> class NaiveBayesClassifier {
     /**
      * @brief Predict the classes of all samples in the given sample vector.
      *
+     * Samples are scored in batches of ir::SCORE_BATCH_SIZE documents using
+     * ir::score_batch.
+     *
      * @param x_pred vector of samples to predict.
      *
      * @return Class of each sample in the given order.
      */
     std::vector<Class> predict(const std::vector<sample<Word>>& x_pred) const;
 
+    /**
+     * @brief Predict the classes of all samples in the given sample vector
+     * using the threads of the given pool.
+     *
+     * Samples are split into chunks of ir::SCORE_BATCH_SIZE documents that
+     * are scored independently by the threads of the pool. Each prediction is
+     * written to the position of its sample; hence, the output is the same as
+     * the output of the single threaded version.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return Class of each sample in the given order.
+     */
+    std::vector<Class> predict(const std::vector<sample<Word>>& x_pred,
+                               ThreadPool& pool) const;
+
+    /**
+     * @brief Compute the log posterior probability of every class for all
+     * samples in the given sample vector.
+     *
+     * Samples are scored in batches as in NaiveBayesClassifier::predict, and
+     * the scores of each sample are normalized by ir::normalize_log_proba.
+     *
+     * @param x_pred vector of samples to predict.
+     *
+     * @return Log posterior of each class in NaiveBayesClassifier::classes
+     * order for each sample in the given order.
+     */
+    std::vector<std::vector<double>>
+    predict_log_proba(const std::vector<sample<Word>>& x_pred) const;
+
+    /**
+     * @brief Compute the log posterior probabilities as in
+     * NaiveBayesClassifier::predict_log_proba using the threads of the given
+     * pool.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return Log posterior of each class for each sample.
+     */
+    std::vector<std::vector<double>>
+    predict_log_proba(const std::vector<sample<Word>>& x_pred,
+                      ThreadPool& pool) const;
+
+    /**
+     * @brief Compute the posterior probability of every class for all samples
+     * in the given sample vector.
+     *
+     * @param x_pred vector of samples to predict.
+     *
+     * @return Posterior of each class in NaiveBayesClassifier::classes order
+     * for each sample in the given order. Posteriors of a sample sum to 1.
+     */
+    std::vector<std::vector<double>>
+    predict_proba(const std::vector<sample<Word>>& x_pred) const;
+
+    /**
+     * @brief Compute the posterior probabilities as in
+     * NaiveBayesClassifier::predict_proba using the threads of the given pool.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return Posterior of each class for each sample.
+     */
+    std::vector<std::vector<double>>
+    predict_proba(const std::vector<sample<Word>>& x_pred,
+                  ThreadPool& pool) const;
+
+    /**
+     * @brief Return the k most probable classes of all samples in the given
+     * sample vector together with their posterior probabilities.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param k Number of classes to return per sample.
+     *
+     * @return <class,posterior> pairs of each sample in decreasing order of
+     * posteriors, as ordered by ir::top_k_scores.
+     */
+    std::vector<std::vector<std::pair<Class, double>>>
+    predict_top_k(const std::vector<sample<Word>>& x_pred, size_t k) const;
+
+    /**
+     * @brief Return the k most probable classes as in
+     * NaiveBayesClassifier::predict_top_k using the threads of the given pool.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param k Number of classes to return per sample.
+     * @param pool ThreadPool whose threads will score the samples.
+     *
+     * @return <class,posterior> pairs of each sample.
+     */
+    std::vector<std::vector<std::pair<Class, double>>>
+    predict_top_k(const std::vector<sample<Word>>& x_pred, size_t k,
+                  ThreadPool& pool) const;
+
+    /**
+     * @brief Get the classes in the order of the columns of
+     * NaiveBayesClassifier::table.
+     *
+     * @return const-reference to vector of classes.
+     */
+    const std::vector<Class>& classes() const;
+
+    /**
+     * @brief Get a view of the compiled log-probability tables.
+     *
+     * Rows of the likelihood table are assigned to words in the dictionary,
+     * and the last row is used for words that are not in the dictionary.
+     *
+     * If the tables are out of date after NaiveBayesClassifier::partial_fit,
+     * they are rebuilt first.
+     *
+     * @return ir::log_prob_table view valid until this object is modified.
+     */
+    log_prob_table table() const;
+
+    /**
+     * @brief Return the row of the given word in NaiveBayesClassifier::table.
+     *
+     * @param word Word whose row will be returned.
+     *
+     * @return Row of the word if it is in the dictionary; row of unseen words,
+     * otherwise.
+     */
+    size_t row_of(const Word& word) const;
+
+    /**
+     * @brief Return the log prior of a class.
+     *
+     * @param class_count Number of documents of the class.
+     * @param total_samples Total number of documents.
+     *
+     * @return Log prior \f$\log{p(c)}\f$.
+     */
+    static double log_prior(size_t class_count, size_t total_samples);
+
+    /**
+     * @brief Return the Laplace smoothed log likelihood of a <word,class>
+     * pair.
+     *
+     * @param count Number of occurrences of the word in documents of the
+     * class.
+     * @param class_term_count Total number of terms in documents of the class.
+     * @param dict_size Number of words in the dictionary.
+     *
+     * @return Log likelihood \f$\log{p(w|c)}\f$.
+     */
+    static double log_likelihood(size_t count, size_t class_term_count,
+                                 size_t dict_size);
+
     /**
      * @brief Get the prior class distribution.
      *
@@ -138,12 +371,194 @@ template <typename Word, typename Class> class NaiveBayesClassifier {
     const likelihood_t& likelihood() const;
 
   private:
-    size_t m_dict_size;             // size of dictionary in the training set
+    /**
+     * @brief Add the class and <word,class> counts of samples in range
+     * [beg, end) of the given training set to the given counts.
+     *
+     * @param x_train vector of document samples.
+     * @param y_train vector of classes.
+     * @param beg Index of the first sample to count.
+     * @param end Index one past the last sample to count.
+     * @param prior Prior class counts to add to.
+     * @param likelihood Marginal likelihood counts to add to.
+     */
+    static void count_samples(const std::vector<sample<Word>>& x_train,
+                              const std::vector<Class>& y_train, size_t beg,
+                              size_t end, prior_t& prior,
+                              likelihood_t& likelihood);
+
+    /**
+     * @brief Add the given source counts to the given destination counts.
+     *
+     * @param prior Prior class counts to add to.
+     * @param likelihood Marginal likelihood counts to add to.
+     * @param src_prior Prior class counts to add.
+     * @param src_likelihood Marginal likelihood counts to add.
+     */
+    static void add_counts(prior_t& prior, likelihood_t& likelihood,
+                           const prior_t& src_prior,
+                           const likelihood_t& src_likelihood);
+
+    /**
+     * @brief Return the column of the given class, adding a column for it if
+     * it is seen for the first time.
+     *
+     * @param cls Class whose column will be returned.
+     *
+     * @return Index of the class in m_class_vec.
+     */
+    size_t add_class(const Class& cls);
+
+    /**
+     * @brief Add the given count of a <word,class> pair to the counts and the
+     * derived fields, assigning a new row to the word if it is seen for the
+     * first time.
+     *
+     * @param word Word to count.
+     * @param cls Class of the document the word occurs in.
+     * @param index Column of the class as returned by
+     * NaiveBayesClassifier::add_class.
+     * @param count Number of occurrences to add.
+     */
+    void add_word_count(const Word& word, const Class& cls, size_t index,
+                        size_t count);
+
+    /**
+     * @brief Recompute the derived fields from the prior and likelihood
+     * counts and mark the contiguous log-probability tables used during
+     * prediction out of date.
+     *
+     * Each word in the dictionary is assigned a row in m_log_likelihood which
+     * stores the Laplace smoothed log likelihood \f$\log{p(w|c)}\f$ of that
+     * word for every class in m_class_vec order. An additional last row stores
+     * the log likelihood of words that are not in the dictionary. Hence,
+     * predicting a sample requires a single hash lookup per word followed by a
+     * contiguous row read, and no logarithms are computed at prediction time.
+     *
+     * This function is called after the counts are replaced as a whole. The
+     * tables are built by NaiveBayesClassifier::ensure_tables when they are
+     * used first.
+     */
+    void compile();
+
+    /**
+     * @brief Build the log-probability tables from the counts and the derived
+     * fields (m_class_vec, m_class_term_counts, m_dict_size, total_samples
+     * and m_word_rows) which must be up to date.
+     */
+    void build_tables() const;
+
+    /**
+     * @brief Rebuild the log-probability tables if they were marked out of
+     * date by an incremental update.
+     *
+     * Concurrent callers wait for a single rebuild; hence, this function can
+     * be called from the threads scoring samples with this object.
+     */
+    void ensure_tables() const;
+
+    /**
+     * @brief Flag marking the log-probability tables out of date together with
+     * the mutex serializing their rebuild.
+     *
+     * A copy gets the flag of the original and a mutex of its own so that
+     * classifiers remain copyable and movable.
+     */
+    struct table_state {
+        std::atomic<bool> stale{false};
+        std::mutex mutex;
+
+        table_state() = default;
+        table_state(const table_state& other) : stale(other.stale.load()) {}
+        table_state& operator=(const table_state& other) {
+            stale.store(other.stale.load());
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Return a pointer to the beginning of the log likelihood row of
+     * the given word.
+     *
+     * @param word Word whose row will be returned.
+     *
+     * @return Pointer to m_class_vec.size() many log likelihoods. If the word
+     * is not in the dictionary, row of unseen words is returned.
+     */
+    const double* log_likelihood_row(const Word& word) const;
+
+    /**
+     * @brief Return the class with the maximum score in the given row of
+     * scores.
+     *
+     * @param scores Scores of each class in m_class_vec order.
+     *
+     * @return Class with the maximum score.
+     */
+    Class best_class(const double* scores) const;
+
+    /**
+     * @brief Predict the classes of samples in range [beg, end) of the given
+     * sample vector in batches and write them to the same positions of y_pred.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param beg Index of the first sample to predict.
+     * @param end Index one past the last sample to predict.
+     * @param y_pred Output array of predictions with x_pred.size() elements.
+     */
+    void predict_range(const std::vector<sample<Word>>& x_pred, size_t beg,
+                       size_t end, Class* y_pred) const;
+
+    /**
+     * @brief Compute the log posteriors of samples in range [beg, end) of the
+     * given sample vector in batches and write them to the same positions of
+     * log_proba.
+     *
+     * @param x_pred vector of samples to predict.
+     * @param beg Index of the first sample to predict.
+     * @param end Index one past the last sample to predict.
+     * @param log_proba Output array of log posteriors with x_pred.size()
+     * elements.
+     */
+    void log_proba_range(const std::vector<sample<Word>>& x_pred, size_t beg,
+                         size_t end, std::vector<double>* log_proba) const;
+
+    /**
+     * @brief Exponentiate the given log posteriors.
+     *
+     * @param log_proba Log posteriors of each class for each sample.
+     *
+     * @return Posteriors of each class for each sample.
+     */
+    static std::vector<std::vector<double>>
+    to_proba(std::vector<std::vector<double>> log_proba);
+
+    /**
+     * @brief Return the k most probable classes of each sample.
+     *
+     * @param proba Posteriors of each class for each sample.
+     * @param k Number of classes to return per sample.
+     *
+     * @return <class,posterior> pairs of each sample.
+     */
+    std::vector<std::vector<std::pair<Class, double>>>
+    top_k_classes(const std::vector<std::vector<double>>& proba,
+                  size_t k) const;
+
+    size_t m_dict_size = 0;         // size of dictionary in the training set
     std::vector<Class> m_class_vec; // classes in the training set
     std::vector<size_t> m_class_term_counts; // number of terms in each class
-    size_t total_samples;      // total number of documents in the training set
+    size_t total_samples = 0;  // total number of documents in the training set
     prior_t m_prior;           // prior class count distribution
     likelihood_t m_likelihood; // marginal likelihood count distribution
+
+    std::unordered_map<Word, size_t> m_word_rows; // row of each word
+
+    // tables are rebuilt lazily from const member functions
+    mutable table_state m_table_state; // whether the tables are out of date
+    mutable size_t m_stride = 0; // number of doubles in a row of the tables
+    mutable std::vector<double> m_log_prior; // log prior of each class
+    mutable std::vector<double> m_log_likelihood; // (m_dict_size + 1) x m_stride
 };
 
 /**
@@ -181,37 +596,18 @@ std::istream& operator>>(std::istream& is,
 template <typename Word, typename Class>
 NaiveBayesClassifier<Word, Class>::NaiveBayesClassifier(
     const prior_t& prior, const likelihood_t& likelihood)
-    : m_dict_size(0), m_class_vec(), m_class_term_counts(prior.size(), 0),
-      total_samples(std::accumulate(prior.begin(), prior.end(), size_t(),
-                                    [](size_t curr_sum, const auto& pair) {
-                                        return curr_sum + pair.second;
-                                    })),
-      m_prior(prior), m_likelihood(likelihood) {
-
-    std::set<Word> dict;
-    for (const auto& pair : likelihood) {
-        dict.insert(pair.first);
-    }
-    m_dict_size = dict.size();
-
-    // store list of classes
-    for (const auto& pair : prior) {
-        m_class_vec.push_back(pair.first);
-    }
-
-    // store class term counts
-    for (const auto& pair : likelihood) {
-        for (const auto& class_count_pair : pair.second) {
-            const Class& cls = class_count_pair.first;
-            const size_t count = class_count_pair.second;
-
-            const auto index = std::distance(
-                m_class_vec.begin(),
-                std::find(m_class_vec.begin(), m_class_vec.end(), cls));
+    : m_dict_size(0), m_class_vec(), m_class_term_counts(), total_samples(0),
+      m_prior(prior), m_likelihood(likelihood), m_stride(0) {
+    compile();
+}
 
-            m_class_term_counts[index] += count;
-        }
-    }
+template <typename Word, typename Class>
+NaiveBayesClassifier<Word, Class>::NaiveBayesClassifier(
+    prior_t&& prior, likelihood_t&& likelihood)
+    : m_dict_size(0), m_class_vec(), m_class_term_counts(), total_samples(0),
+      m_prior(std::move(prior)), m_likelihood(std::move(likelihood)),
+      m_stride(0) {
+    compile();
 }
 
 template <typename Word, typename Class>
@@ -223,102 +619,453 @@ NaiveBayesClassifier<Word, Class>::fit(const std::vector<sample<Word>>& x_train,
     m_prior.clear();
     m_likelihood.clear();
 
-    // Compute class prior counts
-    for (const Class& c : y_train) {
-        ++m_prior[c];
+    // Compute class prior counts and marginal likelihood count for each
+    // <word,class> pair
+    count_samples(x_train, y_train, 0, x_train.size(), m_prior, m_likelihood);
+
+    compile();
+
+    return *this;
+}
+
+template <typename Word, typename Class>
+NaiveBayesClassifier<Word, Class>&
+NaiveBayesClassifier<Word, Class>::fit(const std::vector<sample<Word>>& x_train,
+                                       const std::vector<Class>& y_train,
+                                       ThreadPool& pool) {
+    assert(x_train.size() == y_train.size());
+
+    // private counts of each part
+    const size_t n_parts = std::max<size_t>(
+        std::min(pool.size(), x_train.size()), 1);
+    std::vector<prior_t> priors(n_parts);
+    std::vector<likelihood_t> likelihoods(n_parts);
+
+    pool.parallel_for(n_parts, 1, [&](size_t part, size_t) {
+        const size_t beg = part * x_train.size() / n_parts;
+        const size_t end = (part + 1) * x_train.size() / n_parts;
+        count_samples(x_train, y_train, beg, end, priors[part],
+                      likelihoods[part]);
+    });
+
+    // merge the parts pairwise: at each level, part i absorbs part i + step
+    for (size_t step = 1; step < n_parts; step *= 2) {
+        const size_t n_pairs = (n_parts + 2 * step - 1) / (2 * step);
+        pool.parallel_for(n_pairs, 1, [&](size_t pair, size_t) {
+            const size_t dst = pair * 2 * step;
+            const size_t src = dst + step;
+            if (src < n_parts) {
+                add_counts(priors[dst], likelihoods[dst], priors[src],
+                           likelihoods[src]);
+                priors[src].clear();
+                likelihoods[src].clear();
+            }
+        });
     }
 
-    // Construct class mega documents (concatenate all docs belonging to same
-    // class)
-    ir::unordered_enum_map <Class, sample<Word>> class_megadocs;
+    m_prior = std::move(priors[0]);
+    m_likelihood = std::move(likelihoods[0]);
+
+    compile();
+
+    return *this;
+}
+
+template <typename Word, typename Class>
+NaiveBayesClassifier<Word, Class>&
+NaiveBayesClassifier<Word, Class>::partial_fit(
+    const std::vector<sample<Word>>& x_train,
+    const std::vector<Class>& y_train) {
+    assert(x_train.size() == y_train.size());
+
     for (size_t i = 0; i < x_train.size(); ++i) {
+        const Class& cls = y_train[i];
+        const size_t index = add_class(cls);
+
+        ++m_prior[cls];
+        ++total_samples;
+        for (const auto& pair : x_train[i]) {
+            add_word_count(pair.first, cls, index, pair.second);
+        }
+    }
+
+    // tables depend on the size of the dictionary; rebuild them only once
+    // before they are used
+    m_table_state.stale.store(true);
+
+    return *this;
+}
+
+template <typename Word, typename Class>
+NaiveBayesClassifier<Word, Class>&
+NaiveBayesClassifier<Word, Class>::merge(const NaiveBayesClassifier& other) {
+    for (const auto& pair : other.m_prior) {
+        add_class(pair.first);
+        m_prior[pair.first] += pair.second;
+        total_samples += pair.second;
+    }
+
+    for (const auto& word_pair : other.m_likelihood) {
+        for (const auto& class_pair : word_pair.second) {
+            add_word_count(word_pair.first, class_pair.first,
+                           add_class(class_pair.first), class_pair.second);
+        }
+    }
+
+    m_table_state.stale.store(true);
+
+    return *this;
+}
+
+template <typename Word, typename Class>
+size_t NaiveBayesClassifier<Word, Class>::add_class(const Class& cls) {
+    const auto it = std::find(m_class_vec.begin(), m_class_vec.end(), cls);
+    if (it != m_class_vec.end()) {
+        return static_cast<size_t>(std::distance(m_class_vec.begin(), it));
+    }
+
+    // classes seen for the first time get a new column
+    m_class_vec.push_back(cls);
+    m_class_term_counts.push_back(0);
+    return m_class_vec.size() - 1;
+}
+
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::add_word_count(const Word& word,
+                                                       const Class& cls,
+                                                       size_t index,
+                                                       size_t count) {
+    // words seen for the first time get a new row
+    auto& class_counts = m_likelihood[word];
+    if (class_counts.empty() &&
+        m_word_rows.emplace(word, m_dict_size).second) {
+        ++m_dict_size;
+    }
+
+    class_counts[cls] += count;
+    m_class_term_counts[index] += count;
+}
+
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::count_samples(
+    const std::vector<sample<Word>>& x_train, const std::vector<Class>& y_train,
+    size_t beg, size_t end, prior_t& prior, likelihood_t& likelihood) {
+    for (size_t i = beg; i < end; ++i) {
         const sample<Word>& smp = x_train[i];
         const Class& cls = y_train[i];
 
+        ++prior[cls];
         for (const auto& pair : smp) {
             const Word& word = pair.first;
             const size_t count = pair.second;
 
-            class_megadocs[cls][word] += count;
+            likelihood[word][cls] += count;
         }
     }
+}
 
-    // Compute marginal likelihood count for each <word,class> pair
-    for (const auto& pair : class_megadocs) {
-        const Class& cls = pair.first;
-        const sample<Word>& smp = pair.second;
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::add_counts(
+    prior_t& prior, likelihood_t& likelihood, const prior_t& src_prior,
+    const likelihood_t& src_likelihood) {
+    for (const auto& pair : src_prior) {
+        prior[pair.first] += pair.second;
+    }
 
-        for (const auto& sample_pair : smp) {
-            const Word& word = sample_pair.first;
-            const size_t count = sample_pair.second;
+    for (const auto& word_pair : src_likelihood) {
+        auto& class_counts = likelihood[word_pair.first];
+        for (const auto& class_pair : word_pair.second) {
+            class_counts[class_pair.first] += class_pair.second;
+        }
+    }
+}
 
-            m_likelihood[word][cls] = count;
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::compile() {
+    // store list of classes and total number of documents
+    m_class_vec.clear();
+    total_samples = 0;
+    for (const auto& pair : m_prior) {
+        m_class_vec.push_back(pair.first);
+        total_samples += pair.second;
+    }
+    const size_t n_classes = m_class_vec.size();
+
+    // every word in the likelihood is a distinct dictionary word
+    m_dict_size = m_likelihood.size();
+
+    // store class term counts and assign a row to each word
+    m_class_term_counts.assign(n_classes, 0);
+    m_word_rows.clear();
+    m_word_rows.reserve(m_dict_size);
+    for (const auto& pair : m_likelihood) {
+        m_word_rows.emplace(pair.first, m_word_rows.size());
+
+        for (const auto& class_count_pair : pair.second) {
+            const Class& cls = class_count_pair.first;
+            const size_t count = class_count_pair.second;
+
+            const auto index = std::distance(
+                m_class_vec.begin(),
+                std::find(m_class_vec.begin(), m_class_vec.end(), cls));
+
+            m_class_term_counts[index] += count;
         }
     }
 
-    return *this;
+    m_table_state.stale.store(true);
 }
 
 template <typename Word, typename Class>
-Class NaiveBayesClassifier<Word, Class>::predict(
-    const sample<Word>& x_pred) const {
-    // Log posterior score of each class
-    ir::unordered_enum_map <Class, double> posterior;
+void NaiveBayesClassifier<Word, Class>::build_tables() const {
+    const size_t n_classes = m_class_vec.size();
 
-    // initialize MAP score with log class priors
-    for (const auto& pair : m_prior) {
-        const Class& cls = pair.first;
-        const size_t count = pair.second;
+    // rows are padded with zeros for the vectorized scoring kernels
+    m_stride = score_stride(n_classes);
 
+    // log class priors
+    m_log_prior.assign(m_stride, 0);
+    for (size_t i = 0; i < n_classes; ++i) {
+        const size_t count = m_prior.at(m_class_vec[i]);
+        m_log_prior[i] = log_prior(count, total_samples);
+    }
+
+    // initialize every row with the log likelihood of an unseen word
+    m_log_likelihood.assign((m_dict_size + 1) * m_stride, 0);
+    for (size_t i = 0; i < n_classes; ++i) {
         const double logprob =
-            std::log(static_cast<double>(count) / total_samples);
-        posterior[cls] = logprob;
+            log_likelihood(0, m_class_term_counts[i], m_dict_size);
+        for (size_t row = 0; row <= m_dict_size; ++row) {
+            m_log_likelihood[row * m_stride + i] = logprob;
+        }
     }
 
+    // overwrite the entries of <word,class> pairs that occur in training set
+    for (const auto& pair : m_likelihood) {
+        const size_t row = m_word_rows.at(pair.first);
+
+        for (const auto& class_count_pair : pair.second) {
+            const Class& cls = class_count_pair.first;
+            const auto index = std::distance(
+                m_class_vec.begin(),
+                std::find(m_class_vec.begin(), m_class_vec.end(), cls));
+
+            m_log_likelihood[row * m_stride + index] =
+                log_likelihood(class_count_pair.second,
+                               m_class_term_counts[index], m_dict_size);
+        }
+    }
+}
+
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::ensure_tables() const {
+    if (!m_table_state.stale.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_table_state.mutex);
+    if (m_table_state.stale.load(std::memory_order_relaxed)) {
+        build_tables();
+        m_table_state.stale.store(false, std::memory_order_release);
+    }
+}
+
+template <typename Word, typename Class>
+double NaiveBayesClassifier<Word, Class>::log_prior(size_t class_count,
+                                                    size_t total_samples) {
+    return std::log(static_cast<double>(class_count) / total_samples);
+}
+
+template <typename Word, typename Class>
+double NaiveBayesClassifier<Word, Class>::log_likelihood(
+    size_t count, size_t class_term_count, size_t dict_size) {
+    const double nom = count;
+    const double denom = class_term_count;
+    return std::log(laplace_smooth(nom, denom, dict_size, 1));
+}
+
+template <typename Word, typename Class>
+const double*
+NaiveBayesClassifier<Word, Class>::log_likelihood_row(const Word& word) const {
+    return m_log_likelihood.data() + row_of(word) * m_stride;
+}
+
+template <typename Word, typename Class>
+size_t NaiveBayesClassifier<Word, Class>::row_of(const Word& word) const {
+    const auto it = m_word_rows.find(word);
+    return it != m_word_rows.end() ? it->second : m_dict_size;
+}
+
+template <typename Word, typename Class>
+Class NaiveBayesClassifier<Word, Class>::best_class(
+    const double* scores) const {
+    // find the class with max posterior
+    return m_class_vec[best_score(scores, m_class_vec.size())];
+}
+
+template <typename Word, typename Class>
+Class NaiveBayesClassifier<Word, Class>::predict(
+    const sample<Word>& x_pred) const {
+    ensure_tables();
+    const size_t n_classes = m_class_vec.size();
+
+    // initialize log posterior score of each class with log class priors
+    std::vector<double> posterior(m_log_prior.begin(),
+                                  m_log_prior.begin() + n_classes);
+
     // Add log marginal likelihood count many times to corresponding class
     // posterior where count is the number of times a word occurs in the given
     // sample x_pred.
-    for (size_t i = 0; i < m_class_vec.size(); ++i) {
-        const Class& cls = m_class_vec[i];
-        const size_t cls_count = m_class_term_counts[i];
-
-        for (const auto& sample_pair : x_pred) {
-            const Word& word = sample_pair.first;
-            const size_t count = sample_pair.second;
-
-            bool exists =
-                m_likelihood.find(word) != m_likelihood.end() &&
-                m_likelihood.at(word).find(cls) != m_likelihood.at(word).end();
-
-            double nom = exists ? m_likelihood.at(word).at(cls) : 0;
-            double denom = cls_count;
-            double logprob =
-                std::log(laplace_smooth(nom, denom, m_dict_size, 1));
-            posterior[cls] += count * logprob;
+    for (const auto& sample_pair : x_pred) {
+        const double* row = log_likelihood_row(sample_pair.first);
+        const size_t count = sample_pair.second;
+
+        for (size_t i = 0; i < n_classes; ++i) {
+            posterior[i] += count * row[i];
         }
     }
 
-    // find the class with max posterior
-    Class map_cls = std::max_element(posterior.begin(), posterior.end(),
-                                     [](const auto& left, const auto& right) {
-                                         return left.second < right.second;
-                                     })
-                        ->first;
-    return map_cls;
+    return best_class(posterior.data());
 }
 
 template <typename Word, typename Class>
 std::vector<Class> NaiveBayesClassifier<Word, Class>::predict(
     const std::vector<sample<Word>>& x_pred) const {
-    // predict class of all samples one-by-one
     std::vector<Class> y_pred(x_pred.size());
-    std::transform(
-        x_pred.begin(), x_pred.end(), y_pred.begin(),
-        [this](const sample<Word>& smp) { return this->predict(smp); });
+    predict_range(x_pred, 0, x_pred.size(), y_pred.data());
 
     return y_pred;
 }
 
+template <typename Word, typename Class>
+std::vector<Class> NaiveBayesClassifier<Word, Class>::predict(
+    const std::vector<sample<Word>>& x_pred, ThreadPool& pool) const {
+    std::vector<Class> y_pred(x_pred.size());
+    pool.parallel_for(x_pred.size(), SCORE_BATCH_SIZE,
+                      [this, &x_pred, &y_pred](size_t beg, size_t end) {
+                          predict_range(x_pred, beg, end, y_pred.data());
+                      });
+
+    return y_pred;
+}
+
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::predict_range(
+    const std::vector<sample<Word>>& x_pred, size_t beg, size_t end,
+    Class* y_pred) const {
+    score_samples(
+        table(), x_pred, beg, end,
+        [this](const Word& word) { return row_of(word); },
+        [this, y_pred](size_t i, const double* scores) {
+            y_pred[i] = best_class(scores);
+        });
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<double>>
+NaiveBayesClassifier<Word, Class>::predict_log_proba(
+    const std::vector<sample<Word>>& x_pred) const {
+    std::vector<std::vector<double>> log_proba(x_pred.size());
+    log_proba_range(x_pred, 0, x_pred.size(), log_proba.data());
+
+    return log_proba;
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<double>>
+NaiveBayesClassifier<Word, Class>::predict_log_proba(
+    const std::vector<sample<Word>>& x_pred, ThreadPool& pool) const {
+    std::vector<std::vector<double>> log_proba(x_pred.size());
+    pool.parallel_for(x_pred.size(), SCORE_BATCH_SIZE,
+                      [this, &x_pred, &log_proba](size_t beg, size_t end) {
+                          log_proba_range(x_pred, beg, end, log_proba.data());
+                      });
+
+    return log_proba;
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<double>>
+NaiveBayesClassifier<Word, Class>::predict_proba(
+    const std::vector<sample<Word>>& x_pred) const {
+    return to_proba(predict_log_proba(x_pred));
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<double>>
+NaiveBayesClassifier<Word, Class>::predict_proba(
+    const std::vector<sample<Word>>& x_pred, ThreadPool& pool) const {
+    return to_proba(predict_log_proba(x_pred, pool));
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<std::pair<Class, double>>>
+NaiveBayesClassifier<Word, Class>::predict_top_k(
+    const std::vector<sample<Word>>& x_pred, size_t k) const {
+    return top_k_classes(predict_proba(x_pred), k);
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<std::pair<Class, double>>>
+NaiveBayesClassifier<Word, Class>::predict_top_k(
+    const std::vector<sample<Word>>& x_pred, size_t k,
+    ThreadPool& pool) const {
+    return top_k_classes(predict_proba(x_pred, pool), k);
+}
+
+template <typename Word, typename Class>
+void NaiveBayesClassifier<Word, Class>::log_proba_range(
+    const std::vector<sample<Word>>& x_pred, size_t beg, size_t end,
+    std::vector<double>* log_proba) const {
+    const size_t n_classes = m_class_vec.size();
+    score_samples(
+        table(), x_pred, beg, end,
+        [this](const Word& word) { return row_of(word); },
+        [log_proba, n_classes](size_t i, const double* scores) {
+            log_proba[i].assign(scores, scores + n_classes);
+            normalize_log_proba(log_proba[i].data(), n_classes);
+        });
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<double>> NaiveBayesClassifier<Word, Class>::to_proba(
+    std::vector<std::vector<double>> log_proba) {
+    for (auto& row : log_proba) {
+        for (double& value : row) {
+            value = std::exp(value);
+        }
+    }
+
+    return log_proba;
+}
+
+template <typename Word, typename Class>
+std::vector<std::vector<std::pair<Class, double>>>
+NaiveBayesClassifier<Word, Class>::top_k_classes(
+    const std::vector<std::vector<double>>& proba, size_t k) const {
+    std::vector<std::vector<std::pair<Class, double>>> top(proba.size());
+    for (size_t i = 0; i < proba.size(); ++i) {
+        const auto& row = proba[i];
+        for (size_t index : top_k_scores(row.data(), row.size(), k)) {
+            top[i].emplace_back(m_class_vec[index], row[index]);
+        }
+    }
+
+    return top;
+}
+
+template <typename Word, typename Class>
+const std::vector<Class>& NaiveBayesClassifier<Word, Class>::classes() const {
+    return this->m_class_vec;
+}
+
+template <typename Word, typename Class>
+log_prob_table NaiveBayesClassifier<Word, Class>::table() const {
+    ensure_tables();
+    return {m_log_prior.data(), m_log_likelihood.data(), m_class_vec.size(),
+            m_stride};
+}
+
 template <typename Word, typename Class>
 const typename NaiveBayesClassifier<Word, Class>::prior_t&
 NaiveBayesClassifier<Word, Class>::prior() const {
@@ -395,7 +1142,8 @@ std::istream& operator>>(std::istream& is,
 
     // construct a new NaiveBayesClassifier from the read model and assign to
     // given reference
-    clf = NaiveBayesClassifier<Word, Class>(prior, likelihood);
+    clf = NaiveBayesClassifier<Word, Class>(std::move(prior),
+                                            std::move(likelihood));
 
     return is;
 }
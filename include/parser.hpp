@@ -17,7 +17,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include "defs.hpp"
 
@@ -124,6 +127,73 @@ const std::string BODY_BEG_TAG = "<BODY>";
  */
 const std::string BODY_END_TAG = "</BODY>";
 
+/**
+ * @brief A single document of a Reuters sgm file.
+ *
+ * Title and body are views into the parsed text; hence, they are valid only
+ * as long as the text they were parsed from.
+ */
+struct sgml_doc {
+    /**
+     * @brief ID of the document as specified by ir::ID_FIELD.
+     */
+    size_t id;
+    /**
+     * @brief Type of the document (train/test).
+     */
+    DocType type;
+    /**
+     * @brief Topics of the document.
+     */
+    std::vector<DocClass> topics;
+    /**
+     * @brief Text between ir::TITLE_BEG_TAG and ir::TITLE_END_TAG.
+     */
+    std::string_view title;
+    /**
+     * @brief Text between ir::BODY_BEG_TAG and ir::BODY_END_TAG.
+     */
+    std::string_view body;
+};
+
+/**
+ * @brief Parse all the documents in the given contents of a Reuters sgm file.
+ *
+ * The text is scanned in place, typically directly from a memory mapped file.
+ * Title and body of each document are returned as views into the text without
+ * copying; hence, the only allocations are the returned vector and the topic
+ * list of each document.
+ *
+ * Raw content of a document is defined as its title and body separated by a
+ * newline character.
+ *
+ * @param text Contents of a Reuters sgm file.
+ *
+ * @return Documents in the order they appear in the text.
+ *
+ * @throws std::invalid_argument if a document does not contain a topic list
+ * or its ir::TXT_BEG_TAG and ir::TXT_END_TAG fields.
+ */
+std::vector<sgml_doc> parse_sgml(std::string_view text);
+
+/**
+ * @brief Split the given contents of a Reuters sgm file into consecutive
+ * chunks of whole documents.
+ *
+ * Each chunk except the first one begins at a line starting with
+ * ir::DOC_HEADER, and each chunk is at least chunk_size bytes long except the
+ * last one. Since no document spans two chunks, chunks can be parsed
+ * independently with ir::parse_sgml and concatenating the results gives the
+ * result of parsing the whole text.
+ *
+ * @param text Contents of a Reuters sgm file.
+ * @param chunk_size Minimum number of bytes in a chunk.
+ *
+ * @return Views of the chunks in the order they appear in the text.
+ */
+std::vector<std::string_view> split_sgml(std::string_view text,
+                                         size_t chunk_size);
+
 /**
  * @brief Parse a Reuters sgm file from the beginning of the given input stream
  * and return a pair of mapping from document IDS to their raw content and
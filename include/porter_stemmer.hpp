@@ -0,0 +1,34 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * @brief Stem the lowercase word in p[i] ... p[j] (inclusive) in place using
+ * the Porter stemming algorithm.
+ *
+ * The state of the stemmer is kept in a context local to the call; hence,
+ * words can be stemmed concurrently from multiple threads.
+ *
+ * @param p Buffer holding the word.
+ * @param i Index of the first character of the word.
+ * @param j Index of the last character of the word.
+ *
+ * @return Index of the last character of the stemmed word. Stemming never
+ * increases word length; hence, the returned index k satisfies i <= k <= j
+ * for words longer than a single character.
+ */
+int stem(char* p, int i, int j);
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ir {
+
+/**
+ * @brief Bounded memo table from words to their Porter stems.
+ *
+ * The table is a fixed array of cache line sized entries, each of which holds
+ * a word and its stem inline; hence, a lookup touches at most
+ * StemCache::ProbeLength consecutive entries and never allocates memory. Words
+ * are stored as fixed size keys consisting of their length followed by their
+ * zero padded characters, so that a key is hashed and compared with a few word
+ * sized operations regardless of its length.
+ *
+ * A word is looked up in the ProbeLength entries starting at its home entry
+ * given by the hash of its key. A new word is stored in the first empty entry
+ * of this window, or replaces the word in its home entry if the window is
+ * full. Words longer than StemCache::MaxWordSize characters are never cached.
+ *
+ * StemCache is not thread-safe; concurrent lookups are safe only if there are
+ * no concurrent insertions.
+ */
+class StemCache {
+  public:
+    /**
+     * @brief Maximum number of characters of a cached word or stem.
+     */
+    static constexpr size_t MaxWordSize = 31;
+
+    /**
+     * @brief Number of consecutive entries a word may be stored in.
+     */
+    static constexpr size_t ProbeLength = 4;
+
+    /**
+     * @brief Construct a table with at least the given number of entries.
+     *
+     * @param capacity Minimum number of entries. It is rounded up to a power
+     * of two. If 0, nothing is cached.
+     */
+    explicit StemCache(size_t capacity = 0);
+
+    /**
+     * @brief Replace the given word with its stem if it is in the table.
+     *
+     * @param word Word to look up.
+     *
+     * @return true if the word is found and replaced with its stem; false,
+     * otherwise.
+     */
+    bool find(std::string& word) const;
+
+    /**
+     * @brief Store the stem of the given word in the table.
+     *
+     * @param word Word whose stem is stored.
+     * @param stem Stem of the word.
+     */
+    void insert(std::string_view word, std::string_view stem);
+
+    /**
+     * @brief Return the number of words stored in the table.
+     *
+     * @return Number of words in the table.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Return every word stored in the table.
+     *
+     * @return Words in the table in entry order.
+     */
+    std::vector<std::string> words() const;
+
+  private:
+    /**
+     * @brief Length of a word followed by its zero padded characters.
+     */
+    struct key_t {
+        char bytes[MaxWordSize + 1];
+    };
+
+    /**
+     * @brief A word and its stem stored inline in a single cache line.
+     */
+    struct alignas(64) entry {
+        key_t word = {}; // empty entries have a zero length
+        key_t stem = {};
+    };
+
+    /**
+     * @brief Return the key of the given word.
+     *
+     * @param word Word of at most MaxWordSize characters.
+     *
+     * @return Key of the word.
+     */
+    static key_t make_key(std::string_view word);
+
+    /**
+     * @brief Return the index of the entry in which the given key is looked up
+     * first.
+     *
+     * @param key Key of a word.
+     *
+     * @return Index of the home entry.
+     */
+    size_t home_of(const key_t& key) const;
+
+    std::vector<entry> m_entries; // power of two many entries
+    size_t m_size = 0;            // number of stored words
+};
+} // namespace ir
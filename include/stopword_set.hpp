@@ -0,0 +1,89 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ir {
+
+/**
+ * @brief Immutable set of words with single probe lookups.
+ *
+ * The set is a minimal perfect hash table built with the hash and displace
+ * method: every word is hashed once with ir::fnv1a_hash, the hash selects a
+ * bucket, and the displacement of the bucket, chosen at construction so that no
+ * two words share a slot, maps the hash to the only slot the word can be in.
+ * Hence, a lookup hashes the word once and compares it with at most one stored
+ * word. The table has exactly as many slots as words.
+ *
+ * The set is never modified after construction; hence, it can be shared by any
+ * number of threads without synchronization.
+ */
+class StopwordSet {
+  public:
+    /**
+     * @brief Construct an empty set.
+     */
+    StopwordSet() = default;
+
+    /**
+     * @brief Construct a set of the given words.
+     *
+     * Duplicate words are stored once.
+     *
+     * @param words Words of the set.
+     *
+     * @throws std::runtime_error if no displacement separates the words of a
+     * bucket, which happens only if two different words have the same hash.
+     */
+    explicit StopwordSet(std::vector<std::string> words);
+
+    /**
+     * @brief Check whether the given word is in the set.
+     *
+     * @param word Word to look up.
+     *
+     * @return true if word is in the set; false, otherwise.
+     */
+    bool contains(std::string_view word) const;
+
+    /**
+     * @brief Return the number of words in the set.
+     *
+     * @return Number of words.
+     */
+    size_t size() const;
+
+  private:
+    /**
+     * @brief Return the slot of a word with the given hash in a bucket with the
+     * given displacement.
+     *
+     * @param hash Hash of the word.
+     * @param displacement Displacement of the bucket of the word.
+     *
+     * @return Slot index.
+     */
+    size_t slot_of(std::uint64_t hash, std::uint32_t displacement) const;
+
+    std::vector<std::uint32_t> m_displacements; // displacement of each bucket
+    std::vector<std::string> m_words;           // word stored at each slot
+};
+} // namespace ir
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace ir {
+
+/**
+ * @brief Instruction set used by the text folding kernels.
+ */
+enum class TextKernel {
+    /**
+     * @brief Portable scalar kernel.
+     */
+    Scalar,
+    /**
+     * @brief Kernel using 128-bit SSE4.2 registers.
+     */
+    SSE42,
+    /**
+     * @brief Kernel using 256-bit AVX2 registers.
+     */
+    AVX2
+};
+
+/**
+ * @brief Return the best text folding kernel supported by the running CPU.
+ *
+ * @return ir::TextKernel to use on this CPU.
+ */
+TextKernel detect_text_kernel();
+
+/**
+ * @brief Convert TextKernel enum to its string representation.
+ *
+ * @param kernel ir::TextKernel enum.
+ *
+ * @return std::string representation of ir::TextKernel.
+ */
+std::string to_string(TextKernel kernel);
+
+/**
+ * @brief Copy the given text to the given buffer with the punctuation
+ * characters removed from anywhere in a token by ir::Tokenizer::normalize
+ * dropped, and ASCII uppercase letters converted to lowercase.
+ *
+ * The dropped characters are <blockquote>' " , < ></blockquote>. Whitespace
+ * characters are kept; hence, folding a whole document and then splitting it
+ * into tokens gives the folded tokens of the document. Every byte of the text
+ * is classified, filtered and lowercased in a single pass using the widest
+ * instruction set reported by ir::detect_text_kernel. All kernels produce the
+ * same output.
+ *
+ * @param src Text to fold.
+ * @param size Number of characters in src.
+ * @param dst Output buffer of at least size characters. It must not overlap
+ * src.
+ *
+ * @return Number of characters written to dst.
+ */
+size_t fold_text(const char* src, size_t size, char* dst);
+
+/**
+ * @brief Fold the given text as in ir::fold_text using the kernel of the given
+ * instruction set.
+ *
+ * @param src Text to fold.
+ * @param size Number of characters in src.
+ * @param dst Output buffer of at least size characters. It must not overlap
+ * src.
+ * @param kernel Instruction set to use. Must be supported by the running CPU.
+ *
+ * @return Number of characters written to dst.
+ */
+size_t fold_text(const char* src, size_t size, char* dst, TextKernel kernel);
+} // namespace ir
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace ir {
+
+/****************************** INTERFACE **********************************/
+
+/**
+ * @brief Reusable pool of worker threads.
+ *
+ * A ThreadPool with N threads owns N - 1 worker threads; the thread calling
+ * ThreadPool::parallel_for takes part in the work as the N-th thread. Hence,
+ * a ThreadPool with a single thread runs everything on the calling thread.
+ * Worker threads are created once and reused by every call.
+ */
+class ThreadPool {
+  public:
+    /**
+     * @brief Construct a ThreadPool with the given number of threads.
+     *
+     * @param n_threads Total number of threads including the calling thread.
+     * If 0, number of hardware threads is used.
+     */
+    explicit ThreadPool(size_t n_threads = 1);
+
+    /**
+     * @brief Finish the queued work and join all worker threads.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Return the total number of threads including the calling thread.
+     *
+     * @return Number of threads.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Split the range [0, n) into chunks of chunk_size many indices
+     * and call func(beg, end) for each chunk [beg, end) on the threads of this
+     * pool.
+     *
+     * Chunks are distributed dynamically; a thread takes the next unprocessed
+     * chunk as soon as it finishes its current one. This function returns when
+     * all the chunks are processed. If func throws an exception, the first
+     * thrown exception is rethrown on the calling thread.
+     *
+     * @tparam Func Function type callable as func(size_t, size_t).
+     *
+     * @param n Number of indices.
+     * @param chunk_size Number of indices in a single chunk.
+     * @param func Function to call on each chunk.
+     */
+    template <typename Func>
+    void parallel_for(size_t n, size_t chunk_size, Func&& func);
+
+  private:
+    /**
+     * @brief Shared state of a single ThreadPool::parallel_for call.
+     */
+    struct ForState {
+        std::function<void(size_t, size_t)> func;
+        size_t n;
+        size_t chunk_size;
+        size_t n_chunks;
+        std::atomic<size_t> next_chunk{0};
+        size_t finished_chunks = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    /**
+     * @brief Process chunks of the given parallel_for call until none is
+     * left.
+     *
+     * @param state Shared state of the call.
+     */
+    static void run_chunks(ForState& state);
+
+    /**
+     * @brief Main loop of a worker thread.
+     */
+    void worker_loop();
+
+    std::vector<std::thread> m_workers;        // worker threads
+    std::queue<std::function<void()>> m_tasks; // tasks waiting for a worker
+    std::mutex m_mutex;                        // guards m_tasks and m_stop
+    std::condition_variable m_task_ready;      // signals a new task or stop
+    bool m_stop = false;                       // true when destructing
+};
+
+/************************** IMPLEMENTATION ********************************/
+
+template <typename Func>
+void ThreadPool::parallel_for(size_t n, size_t chunk_size, Func&& func) {
+    if (n == 0) {
+        return;
+    }
+    chunk_size = std::max<size_t>(chunk_size, 1);
+
+    auto state = std::make_shared<ForState>();
+    state->func = std::forward<Func>(func);
+    state->n = n;
+    state->chunk_size = chunk_size;
+    state->n_chunks = (n + chunk_size - 1) / chunk_size;
+
+    // wake up at most as many workers as there are chunks left for them
+    const size_t n_helpers = std::min(m_workers.size(), state->n_chunks - 1);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < n_helpers; ++i) {
+            m_tasks.emplace([state]() { run_chunks(*state); });
+        }
+    }
+    if (n_helpers == 1) {
+        m_task_ready.notify_one();
+    } else if (n_helpers > 1) {
+        m_task_ready.notify_all();
+    }
+
+    // calling thread works too, then waits for chunks taken by the workers
+    run_chunks(*state);
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() {
+        return state->finished_chunks == state->n_chunks;
+    });
+
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+} // namespace ir
@@ -17,18 +17,59 @@
 #pragma once
 
 #include "defs.hpp"
+#include "stem_cache.hpp"
+#include "stopword_set.hpp"
+#include "vocabulary.hpp"
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 namespace ir {
 
+/**
+ * @brief Number of lookups answered by the stem memo tables of a
+ * ir::Tokenizer and the number of words that had to be stemmed.
+ */
+struct stem_cache_stats {
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
 /**
  * @brief Class to handle tokenization and normalization operations and keep
  * statistics about these operations.
+ *
+ * Stems are memoized in ir::StemCache tables. Every thread normalizing tokens
+ * with a Tokenizer gets its own table of StemCacheSize entries, so lookups
+ * take no locks. Words given to Tokenizer::preload_stems are kept in an
+ * additional table shared by all the threads; hence, they are never stemmed
+ * again.
+ *
+ * The stopword list in ir::STOPWORD_PATH is read once when a Tokenizer is
+ * constructed and kept in an ir::StopwordSet, which is never modified
+ * afterwards; hence, stopword checks are safe to make from any number of
+ * threads.
  */
 class Tokenizer {
   public:
+    /**
+     * @brief Minimum number of entries of the stem memo table of each thread.
+     */
+    static constexpr size_t StemCacheSize = 1 << 14;
+
+    /**
+     * @brief Construct a tokenizer with the stopwords in ir::STOPWORD_PATH and
+     * empty stem memo tables.
+     */
+    Tokenizer();
+
+    Tokenizer(const Tokenizer&) = delete;
+    Tokenizer& operator=(const Tokenizer&) = delete;
+
     /**
      * @brief Split the given string with respect to whitespace characters and
      * return the resulting tokens and their positions in the document as a
@@ -60,6 +101,14 @@ class Tokenizer {
      * whitespace, and then does normalization operations to each token as
      * defined in ir::normalize.
      *
+     * The whole document is first folded with ir::fold_text, which removes
+     * the punctuation characters dropped from anywhere in a token and converts
+     * the document to lowercase in a single vectorized pass. The folded
+     * document is then scanned once with ir::next_token, and only the ends of
+     * every token are trimmed before stopword removal and stemming into a
+     * per-thread scratch buffer; hence, memory is allocated only when a term is
+     * counted for the first time.
+     *
      * @param doc Raw document.
      *
      * @return std::vector of normalized terms and their counts in the given raw
@@ -67,6 +116,19 @@ class Tokenizer {
      */
     ir::doc_sample get_doc_terms(const raw_doc& doc);
 
+    /**
+     * @brief Tokenize and normalize a given raw document and return its terms
+     * and their counts where each term is interned to its id in the given
+     * vocabulary.
+     *
+     * @param doc Raw document.
+     * @param vocab Vocabulary to intern the terms of the document.
+     *
+     * @return ir::id_sample of term ids and their counts in the given raw
+     * document.
+     */
+    ir::id_sample get_doc_terms(const raw_doc& doc, Vocabulary& vocab);
+
     /**
      * @brief Return the normalized version a given token.
      *
@@ -91,6 +153,22 @@ class Tokenizer {
      */
     std::string normalize(const std::string& token);
 
+    /**
+     * @brief Normalize the given token into the given term buffer.
+     *
+     * Normalization steps are the same as in ir::Tokenizer::normalize. The
+     * buffer is overwritten; hence, reusing the same buffer for every token
+     * normalizes tokens without allocating memory once the buffer is as long
+     * as the longest token.
+     *
+     * @param token Token to normalize.
+     * @param term Buffer to store the normalized term.
+     *
+     * @return true if the token has a normalized term; false, if the token is
+     * a stopword or consists only of punctuation characters.
+     */
+    bool normalize(std::string_view token, std::string& term);
+
     /**
      * @brief Normalize all the tokens in the given vector of tokens
      * in-place.
@@ -109,14 +187,98 @@ class Tokenizer {
      * This function simply checks if the given word is in the stopword list
      * defined in ir::STOPWORD_PATH.
      *
-     * For efficiency purposes, the file is read only once when the function
-     * is called for the first time, and the stopword list is sorted. Then,
-     * stopword check is done using binary search.
+     * The list is read when the tokenizer is constructed and stored in a
+     * minimal perfect hash table; hence, a check hashes the word once and
+     * compares it with at most one stopword.
      *
      * @param word Word to check if it is a stopword.
      *
      * @return true if word is in stopword list; false, otherwise.
      */
-    bool is_stopword(const std::string& word);
+    bool is_stopword(std::string_view word) const;
+
+    /**
+     * @brief Stem every whitespace separated word in the given input stream
+     * and keep the stems in the shared memo table.
+     *
+     * Words are expected to be lowercase and free of punctuation, e.g. the
+     * words written by Tokenizer::save_stems in a previous run. This function
+     * must not be called while other threads use this tokenizer.
+     *
+     * @param is Input stream to read the words from.
+     *
+     * @return Number of words read.
+     */
+    size_t preload_stems(std::istream& is);
+
+    /**
+     * @brief Write every word in the memo tables to the given output stream,
+     * one word per line, so that they can be preloaded in a later run.
+     *
+     * This function must not be called while other threads use this
+     * tokenizer.
+     *
+     * @param os Output stream to write the words to.
+     *
+     * @return Modified output stream.
+     */
+    std::ostream& save_stems(std::ostream& os) const;
+
+    /**
+     * @brief Return the number of stem memo hits and misses of all the
+     * threads so far.
+     *
+     * This function must not be called while other threads use this
+     * tokenizer.
+     *
+     * @return Stem memo statistics.
+     */
+    stem_cache_stats stem_stats() const;
+
+  private:
+    /**
+     * @brief Normalize the given token folded with ir::fold_text into the
+     * given term buffer.
+     *
+     * Since folding removes punctuation from anywhere in the token and
+     * converts it to lowercase, only the punctuation at the ends of the token
+     * is removed before stopword removal and stemming.
+     *
+     * @param token Folded token to normalize.
+     * @param term Buffer to store the normalized term.
+     *
+     * @return true if the token has a normalized term; false, otherwise.
+     */
+    bool normalize_folded(std::string_view token, std::string& term);
+
+    /**
+     * @brief Stem memo table of a single thread and its statistics.
+     */
+    struct thread_stem_cache {
+        StemCache cache{StemCacheSize};
+        stem_cache_stats stats;
+    };
+
+    /**
+     * @brief Replace the given lowercase word with its stem, looking it up in
+     * the memo tables first.
+     *
+     * @param word Word to stem in-place.
+     */
+    void stem_word(std::string& word);
+
+    /**
+     * @brief Return the stem memo table of the calling thread, creating it if
+     * the thread uses this tokenizer for the first time.
+     *
+     * @return Memo table of the calling thread.
+     */
+    thread_stem_cache& thread_cache();
+
+    StopwordSet m_stopwords;    // stopwords in ir::STOPWORD_PATH
+    size_t m_id;                // unique id to find the tables of a thread
+    StemCache m_preloaded;      // shared table of preloaded words
+    mutable std::mutex m_mutex; // guards m_caches
+    std::vector<std::unique_ptr<thread_stem_cache>> m_caches;
 };
 } // namespace ir
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ir {
@@ -36,6 +39,81 @@ namespace ir {
  */
 std::vector<std::string> split(std::string& str, const std::string& delimiters);
 
+/**
+ * @brief Return the 64-bit FNV-1a hash of the given bytes.
+ *
+ * Unlike std::hash, this hash is the same on every platform and every run;
+ * hence, it can be stored in files.
+ *
+ * @param data Pointer to the first byte.
+ * @param size Number of bytes to hash.
+ *
+ * @return 64-bit FNV-1a hash value.
+ */
+std::uint64_t fnv1a_hash(const char* data, size_t size);
+
+/**
+ * @brief Return the next line in the given character range and advance the
+ * beginning of the range past it.
+ *
+ * Lines are found with memchr; hence, scanning a memory mapped file line by
+ * line requires no copying.
+ *
+ * @param pos Beginning of the range. It is set to the beginning of the next
+ * line, or to end if there are no more lines.
+ * @param end End of the range.
+ *
+ * @return View of the line without its newline character.
+ */
+inline std::string_view next_line(const char*& pos, const char* end) {
+    const auto* newline = static_cast<const char*>(
+        std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+    const char* line_end = newline != nullptr ? newline : end;
+
+    const std::string_view line(pos, static_cast<size_t>(line_end - pos));
+    pos = newline != nullptr ? newline + 1 : end;
+    return line;
+}
+
+/**
+ * @brief Return the next whitespace separated token in the given character
+ * range and advance the beginning of the range past it.
+ *
+ * Tokens are separated by space, tab, newline, vertical tab, form feed and
+ * carriage return characters. Since tokens are views of the given range, a raw
+ * document is tokenized in a single pass without copying it.
+ *
+ * @param pos Beginning of the range. It is set to the end of the returned
+ * token.
+ * @param end End of the range.
+ *
+ * @return View of the token, or an empty view if there are no more tokens.
+ */
+inline std::string_view next_token(const char*& pos, const char* end) {
+    const auto is_space = [](char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    };
+    while (pos != end && is_space(*pos)) {
+        ++pos;
+    }
+    const char* token_beg = pos;
+    while (pos != end && !is_space(*pos)) {
+        ++pos;
+    }
+    return {token_beg, static_cast<size_t>(pos - token_beg)};
+}
+
+/**
+ * @brief Parse the given string as a non-negative decimal integer.
+ *
+ * @param str String consisting only of decimal digits.
+ * @param value Reference to store the parsed integer.
+ *
+ * @return true if str is a non-empty sequence of decimal digits; false,
+ * otherwise.
+ */
+bool parse_size(std::string_view str, size_t& value);
+
 /**
  * @brief Return Laplace smoothed version of the given fraction.
  *
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ir {
+
+/**
+ * @brief Append the given value to the given buffer as a variable length
+ * integer.
+ *
+ * Each byte stores 7 bits of the value starting from the least significant
+ * ones, and its most significant bit is set if more bytes follow. Hence,
+ * values less than 128 take a single byte, and the encoding does not depend on
+ * the byte order of the host.
+ *
+ * @param out Buffer to append the encoded value to.
+ * @param value Value to encode.
+ */
+inline void append_varint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+/**
+ * @brief Decode the variable length integer written by ir::append_varint at
+ * the given position.
+ *
+ * @param pos Position of the encoded value. It is advanced past the value.
+ * @param end End of the input.
+ * @param value Reference to store the decoded value.
+ *
+ * @return true if a value is decoded; false if the input ends before the value
+ * or the value does not fit in 64 bits.
+ */
+inline bool read_varint(const char*& pos, const char* end,
+                        std::uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; pos != end && shift < 64; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*pos++);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Append the given term to the given buffer front coded against the
+ * previous term.
+ *
+ * A front coded term is stored as the length of its longest common prefix
+ * with the previous term and the length of the remaining suffix, both as
+ * variable length integers, followed by the suffix itself. Consecutive terms
+ * of a sorted dictionary share long prefixes; hence, most of their bytes are
+ * not repeated.
+ *
+ * @param out Buffer to append the encoded term to.
+ * @param prev Previous term of the dictionary; empty for the first term.
+ * @param term Term to encode.
+ */
+inline void append_front_coded(std::string& out, std::string_view prev,
+                               std::string_view term) {
+    const size_t max_shared = std::min(prev.size(), term.size());
+    size_t shared = 0;
+    while (shared < max_shared && prev[shared] == term[shared]) {
+        ++shared;
+    }
+
+    append_varint(out, shared);
+    append_varint(out, term.size() - shared);
+    out.append(term.data() + shared, term.size() - shared);
+}
+
+/**
+ * @brief Decode the front coded term written by ir::append_front_coded at the
+ * given position.
+ *
+ * @param pos Position of the encoded term. It is advanced past the term.
+ * @param end End of the input.
+ * @param term Previous term of the dictionary on input, which is replaced
+ * with the decoded term in place.
+ *
+ * @return true if a term is decoded; false if the input is malformed.
+ */
+inline bool read_front_coded(const char*& pos, const char* end,
+                             std::string& term) {
+    std::uint64_t shared, suffix;
+    if (!read_varint(pos, end, shared) || shared > term.size() ||
+        !read_varint(pos, end, suffix) ||
+        suffix > static_cast<std::uint64_t>(end - pos)) {
+        return false;
+    }
+
+    term.resize(shared);
+    term.append(pos, suffix);
+    pos += suffix;
+    return true;
+}
+} // namespace ir
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "defs.hpp"
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ir {
+
+/**
+ * @brief Class that interns terms to dense integer ids.
+ *
+ * Each distinct term is assigned the next unused ir::term_id when it is
+ * interned for the first time; hence, ids of a vocabulary with N terms are
+ * exactly 0, 1, ..., N - 1. Documents can then be represented as
+ * ir::id_sample objects, and strings need only be touched when reading or
+ * writing files.
+ *
+ * Terms are looked up by std::string_view; hence, terms can be interned
+ * directly from a mapped file without constructing a std::string unless the
+ * term is new.
+ */
+class Vocabulary {
+  public:
+    Vocabulary() = default;
+
+    // index holds views into the stored terms; hence, it cannot be copied
+    Vocabulary(const Vocabulary&) = delete;
+    Vocabulary& operator=(const Vocabulary&) = delete;
+    Vocabulary(Vocabulary&&) = default;
+    Vocabulary& operator=(Vocabulary&&) = default;
+
+    /**
+     * @brief Id returned by Vocabulary::find for terms that are not in the
+     * vocabulary.
+     */
+    static constexpr term_id npos = std::numeric_limits<term_id>::max();
+
+    /**
+     * @brief Return the id of the given term, assigning a new id if the term
+     * is not in the vocabulary.
+     *
+     * @param term Term to intern.
+     *
+     * @return Id of the term.
+     */
+    term_id intern(std::string_view term);
+
+    /**
+     * @brief Return the id of the given term without modifying the vocabulary.
+     *
+     * @param term Term to look up.
+     *
+     * @return Id of the term if it is in the vocabulary; Vocabulary::npos,
+     * otherwise.
+     */
+    term_id find(std::string_view term) const;
+
+    /**
+     * @brief Return the term with the given id.
+     *
+     * @param id Id of a term in the vocabulary.
+     *
+     * @return const-reference to the term.
+     */
+    const std::string& term(term_id id) const;
+
+    /**
+     * @brief Return the number of terms in the vocabulary.
+     *
+     * @return Number of distinct terms interned so far.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Convert a sample keyed by terms to a sample keyed by term ids,
+     * interning every unseen term.
+     *
+     * @param doc Sample keyed by terms.
+     *
+     * @return Sample keyed by ir::term_id.
+     */
+    id_sample to_ids(const doc_sample& doc);
+
+    /**
+     * @brief Convert a sample keyed by term ids back to a sample keyed by
+     * terms.
+     *
+     * @param doc Sample keyed by ir::term_id of this vocabulary.
+     *
+     * @return Sample keyed by terms.
+     */
+    doc_sample to_terms(const id_sample& doc) const;
+
+  private:
+    std::unordered_map<std::string_view, term_id> m_ids; // term to id
+    std::deque<std::string> m_terms; // id to term, never relocated
+};
+} // namespace ir
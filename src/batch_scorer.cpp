@@ -0,0 +1,212 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batch_scorer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define IR_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Portable batch scoring kernel.
+ *
+ * @param table Log-probability tables.
+ * @param batch Batch of documents.
+ * @param scores Output scores.
+ */
+static void score_batch_scalar(const ir::log_prob_table& table,
+                               const ir::sparse_batch& batch, double* scores) {
+    const size_t stride = table.stride;
+    for (size_t doc = 0; doc < batch.size(); ++doc) {
+        double* acc = scores + doc * stride;
+        std::copy(table.log_prior, table.log_prior + stride, acc);
+
+        for (size_t e = batch.offsets[doc]; e < batch.offsets[doc + 1]; ++e) {
+            const double* row = table.log_likelihood + batch.rows[e] * stride;
+            const double count = batch.counts[e];
+
+            for (size_t i = 0; i < stride; ++i) {
+                acc[i] += count * row[i];
+            }
+        }
+    }
+}
+
+#ifdef IR_X86_KERNELS
+/**
+ * @brief AVX2 batch scoring kernel.
+ *
+ * Each block of ir::SCORE_ALIGN classes is accumulated in two 256-bit
+ * registers over all the entries of a document.
+ *
+ * @param table Log-probability tables.
+ * @param batch Batch of documents.
+ * @param scores Output scores.
+ */
+__attribute__((target("avx2"))) static void
+score_batch_avx2(const ir::log_prob_table& table, const ir::sparse_batch& batch,
+                 double* scores) {
+    const size_t stride = table.stride;
+    for (size_t doc = 0; doc < batch.size(); ++doc) {
+        const size_t beg = batch.offsets[doc];
+        const size_t end = batch.offsets[doc + 1];
+
+        for (size_t col = 0; col < stride; col += ir::SCORE_ALIGN) {
+            __m256d acc_lo = _mm256_loadu_pd(table.log_prior + col);
+            __m256d acc_hi = _mm256_loadu_pd(table.log_prior + col + 4);
+
+            for (size_t e = beg; e < end; ++e) {
+                const double* row =
+                    table.log_likelihood + batch.rows[e] * stride + col;
+                const __m256d count = _mm256_set1_pd(batch.counts[e]);
+
+                // multiply and add separately to match the scalar kernel
+                acc_lo = _mm256_add_pd(
+                    acc_lo, _mm256_mul_pd(count, _mm256_loadu_pd(row)));
+                acc_hi = _mm256_add_pd(
+                    acc_hi, _mm256_mul_pd(count, _mm256_loadu_pd(row + 4)));
+            }
+
+            _mm256_storeu_pd(scores + doc * stride + col, acc_lo);
+            _mm256_storeu_pd(scores + doc * stride + col + 4, acc_hi);
+        }
+    }
+}
+
+/**
+ * @brief AVX-512 batch scoring kernel.
+ *
+ * Each block of ir::SCORE_ALIGN classes is accumulated in a single 512-bit
+ * register over all the entries of a document.
+ *
+ * @param table Log-probability tables.
+ * @param batch Batch of documents.
+ * @param scores Output scores.
+ */
+__attribute__((target("avx512f"))) static void
+score_batch_avx512(const ir::log_prob_table& table,
+                   const ir::sparse_batch& batch, double* scores) {
+    const size_t stride = table.stride;
+    for (size_t doc = 0; doc < batch.size(); ++doc) {
+        const size_t beg = batch.offsets[doc];
+        const size_t end = batch.offsets[doc + 1];
+
+        for (size_t col = 0; col < stride; col += ir::SCORE_ALIGN) {
+            __m512d acc = _mm512_loadu_pd(table.log_prior + col);
+
+            for (size_t e = beg; e < end; ++e) {
+                const double* row =
+                    table.log_likelihood + batch.rows[e] * stride + col;
+                const __m512d count = _mm512_set1_pd(batch.counts[e]);
+
+                // multiply and add separately to match the scalar kernel
+                acc = _mm512_add_pd(acc,
+                                    _mm512_mul_pd(count, _mm512_loadu_pd(row)));
+            }
+
+            _mm512_storeu_pd(scores + doc * stride + col, acc);
+        }
+    }
+}
+#endif
+
+ir::SimdLevel ir::detect_simd_level() {
+#ifdef IR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+std::string ir::to_string(ir::SimdLevel level) {
+    switch (level) {
+    case ir::SimdLevel::Scalar:
+        return "scalar";
+    case ir::SimdLevel::AVX2:
+        return "avx2";
+    case ir::SimdLevel::AVX512:
+        return "avx512";
+    }
+    return "";
+}
+
+void ir::score_batch(const log_prob_table& table, const sparse_batch& batch,
+                     double* scores) {
+    // CPU features are checked only once
+    static const SimdLevel level = detect_simd_level();
+    score_batch(table, batch, scores, level);
+}
+
+void ir::score_batch(const log_prob_table& table, const sparse_batch& batch,
+                     double* scores, SimdLevel level) {
+    switch (level) {
+#ifdef IR_X86_KERNELS
+    case SimdLevel::AVX512:
+        score_batch_avx512(table, batch, scores);
+        break;
+    case SimdLevel::AVX2:
+        score_batch_avx2(table, batch, scores);
+        break;
+#endif
+    default:
+        score_batch_scalar(table, batch, scores);
+        break;
+    }
+}
+
+void ir::normalize_log_proba(double* scores, size_t n_classes) {
+    if (n_classes == 0) {
+        return;
+    }
+
+    const double max = *std::max_element(scores, scores + n_classes);
+    double sum = 0;
+    for (size_t i = 0; i < n_classes; ++i) {
+        sum += std::exp(scores[i] - max);
+    }
+
+    const double log_norm = max + std::log(sum);
+    for (size_t i = 0; i < n_classes; ++i) {
+        scores[i] -= log_norm;
+    }
+}
+
+std::vector<size_t> ir::top_k_scores(const double* scores, size_t n_classes,
+                                     size_t k) {
+    std::vector<size_t> indices(n_classes);
+    for (size_t i = 0; i < n_classes; ++i) {
+        indices[i] = i;
+    }
+
+    k = std::min(k, n_classes);
+    std::partial_sort(indices.begin(), indices.begin() + k, indices.end(),
+                      [scores](size_t lhs, size_t rhs) {
+                          return scores[lhs] > scores[rhs] ||
+                                 (scores[lhs] == scores[rhs] && lhs < rhs);
+                      });
+    indices.resize(k);
+
+    return indices;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include "dataset_cache.hpp"
+#include "file_manager.hpp"
+#include "mapped_file.hpp"
+#include "util.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+/**
+ * @brief Size and modification time of a file.
+ */
+struct file_stat {
+    std::uint64_t size;
+    std::int64_t mtime; // nanoseconds since epoch
+};
+
+/**
+ * @brief Metadata of a cache entry as stored in its metadata file.
+ */
+struct entry_meta {
+    std::string path;             // path of the source file
+    std::uint64_t version;        // ir::DATASET_CACHE_VERSION of the shards
+    std::uint64_t stopwords_hash; // FNV-1a hash of ir::STOPWORD_PATH
+    std::uint64_t size;           // size of the source file
+    std::int64_t mtime;           // modification time of the source file
+    std::uint64_t hash;           // FNV-1a hash of the source file content
+    size_t n_train;               // number of documents in the train shard
+    size_t n_test;                // number of documents in the test shard
+};
+
+/**
+ * @brief Get the size and modification time of the file in the given path.
+ *
+ * @param path Path of a file.
+ * @param result Reference to store the size and modification time.
+ *
+ * @return true if the file exists; false, otherwise.
+ */
+static bool stat_file(const std::string& path, file_stat& result) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1) {
+        return false;
+    }
+
+    result.size = static_cast<std::uint64_t>(st.st_size);
+    result.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                   st.st_mtim.tv_nsec;
+    return true;
+}
+
+/**
+ * @brief Read the metadata file in the given path.
+ *
+ * The first line of a metadata file is the path of the source file, and the
+ * second line contains the cache version, stopword list hash, size,
+ * modification time, content hash, number of train documents and number of
+ * test documents separated by spaces.
+ *
+ * @param meta_path Path of the metadata file.
+ * @param meta Reference to store the read metadata.
+ *
+ * @return true if the metadata is read; false if the file does not exist or
+ * is malformed.
+ */
+static bool read_meta(const std::string& meta_path, entry_meta& meta) {
+    std::ifstream ifs(meta_path);
+    return std::getline(ifs, meta.path) &&
+           (ifs >> meta.version >> meta.stopwords_hash >> meta.size >>
+            meta.mtime >> meta.hash >> meta.n_train >> meta.n_test);
+}
+
+/**
+ * @brief Write the given metadata to the metadata file in the given path.
+ *
+ * The metadata is first written to a temporary file which then replaces the
+ * metadata file; hence, a metadata file is never left half written.
+ *
+ * @param meta_path Path of the metadata file.
+ * @param meta Metadata to write.
+ *
+ * @throws std::runtime_error if the file cannot be written.
+ */
+static void write_meta(const std::string& meta_path, const entry_meta& meta) {
+    const std::string tmp_path = meta_path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios_base::trunc);
+        ofs << meta.path << '\n'
+            << meta.version << ' ' << meta.stopwords_hash << ' ' << meta.size
+            << ' ' << meta.mtime << ' ' << meta.hash << ' ' << meta.n_train
+            << ' ' << meta.n_test << '\n';
+        if (!ofs.flush()) {
+            throw std::runtime_error("Cannot write " + tmp_path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), meta_path.c_str()) != 0) {
+        throw std::runtime_error("Cannot write " + meta_path);
+    }
+}
+
+/**
+ * @brief Return the FNV-1a hash of the content of ir::STOPWORD_PATH.
+ *
+ * A missing stopword file is hashed as an empty file, as the tokenizer then
+ * uses no stopwords.
+ *
+ * @return 64-bit FNV-1a hash value.
+ */
+static std::uint64_t hash_stopwords() {
+    std::ifstream ifs(ir::STOPWORD_PATH, std::ios_base::binary);
+    std::ostringstream oss;
+    // copying an empty stream buffer sets failbit of the output stream
+    if (ifs.peek() != std::ifstream::traits_type::eof()) {
+        oss << ifs.rdbuf();
+    }
+    const std::string content = oss.str();
+    return ir::fnv1a_hash(content.data(), content.size());
+}
+
+ir::DatasetCache::DatasetCache(const std::string& dir)
+    : m_dir(dir), m_stopwords_hash(hash_stopwords()) {
+    if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create " + dir);
+    }
+}
+
+bool ir::DatasetCache::lookup(const std::string& source_path, size_t& n_train,
+                              size_t& n_test) {
+    const std::string meta_path = entry_path(source_path) + ".meta";
+    entry_meta meta;
+    file_stat source, shard;
+    if (!read_meta(meta_path, meta) || meta.path != source_path ||
+        meta.version != DATASET_CACHE_VERSION ||
+        meta.stopwords_hash != m_stopwords_hash ||
+        !stat_file(source_path, source) || source.size != meta.size ||
+        !stat_file(train_shard(source_path), shard) ||
+        !stat_file(test_shard(source_path), shard)) {
+        return false;
+    }
+
+    // file is touched since the shards are built; compare its content
+    if (source.mtime != meta.mtime) {
+        const MappedFile file(source_path);
+        if (fnv1a_hash(file.data(), file.size()) != meta.hash) {
+            return false;
+        }
+        meta.mtime = source.mtime;
+        write_meta(meta_path, meta);
+    }
+
+    n_train = meta.n_train;
+    n_test = meta.n_test;
+    return true;
+}
+
+void ir::DatasetCache::invalidate(const std::string& source_path) {
+    std::remove((entry_path(source_path) + ".meta").c_str());
+}
+
+void ir::DatasetCache::store(const std::string& source_path,
+                             std::string_view content, size_t n_train,
+                             size_t n_test) {
+    file_stat source;
+    if (!stat_file(source_path, source)) {
+        throw std::runtime_error("Cannot stat " + source_path);
+    }
+
+    entry_meta meta;
+    meta.path = source_path;
+    meta.version = DATASET_CACHE_VERSION;
+    meta.stopwords_hash = m_stopwords_hash;
+    meta.size = content.size();
+    meta.mtime = source.mtime;
+    meta.hash = fnv1a_hash(content.data(), content.size());
+    meta.n_train = n_train;
+    meta.n_test = n_test;
+    write_meta(entry_path(source_path) + ".meta", meta);
+}
+
+std::string
+ir::DatasetCache::train_shard(const std::string& source_path) const {
+    return entry_path(source_path) + ".train.txt";
+}
+
+std::string ir::DatasetCache::test_shard(const std::string& source_path) const {
+    return entry_path(source_path) + ".test.txt";
+}
+
+std::string ir::DatasetCache::entry_path(const std::string& source_path) const {
+    std::ostringstream oss;
+    oss << m_dir << '/' << std::hex << std::setw(16) << std::setfill('0')
+        << fnv1a_hash(source_path.data(), source_path.size());
+    return oss.str();
+}
@@ -0,0 +1,683 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dataset_file.hpp"
+#include "util.hpp"
+#include "varint.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+std::ostream& ir::write_binary_dataset(std::ostream& os,
+                                       const id_term_index& term_index,
+                                       const doc_class_index& class_index,
+                                       const Vocabulary& vocab) {
+    const size_t n_docs = term_index.size();
+
+    // dictionary of the terms occurring in the dataset in order of appearance
+    std::vector<std::uint32_t> dict_index(vocab.size(), UINT32_MAX);
+    std::vector<term_id> dict;
+
+    std::vector<std::uint64_t> ids;
+    std::vector<std::uint32_t> classes;
+    std::vector<std::uint64_t> doc_offsets = {0};
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> entries;
+    ids.reserve(n_docs);
+    classes.reserve(n_docs);
+    doc_offsets.reserve(n_docs + 1);
+    for (const auto& pair : term_index) {
+        ids.push_back(pair.first);
+        classes.push_back(
+            static_cast<std::uint32_t>(class_index.at(pair.first)));
+
+        const size_t doc_beg = entries.size();
+        for (const auto& term_count_pair : pair.second) {
+            std::uint32_t& index = dict_index[term_count_pair.first];
+            if (index == UINT32_MAX) {
+                index = static_cast<std::uint32_t>(dict.size());
+                dict.push_back(term_count_pair.first);
+            }
+            entries.emplace_back(
+                index, static_cast<std::uint32_t>(term_count_pair.second));
+        }
+        std::sort(entries.begin() + doc_beg, entries.end());
+        doc_offsets.push_back(entries.size());
+    }
+    const size_t n_entries = entries.size();
+
+    std::vector<std::uint32_t> term_ids(n_entries);
+    std::vector<std::uint32_t> counts(n_entries);
+    for (size_t i = 0; i < n_entries; ++i) {
+        term_ids[i] = entries[i].first;
+        counts[i] = entries[i].second;
+    }
+
+    std::vector<std::uint64_t> str_offsets(dict.size() + 1, 0);
+    for (size_t t = 0; t < dict.size(); ++t) {
+        str_offsets[t + 1] = str_offsets[t] + vocab.term(dict[t]).size();
+    }
+
+    // lay out the sections
+    binary_dataset_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BINARY_DATASET_MAGIC, sizeof(header.magic));
+    header.version = BINARY_DATASET_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.n_docs = n_docs;
+    header.n_entries = n_entries;
+    header.n_terms = dict.size();
+
+    size_t offset = sizeof(header);
+    auto place = [&offset](size_t size) {
+        offset = (offset + 7) / 8 * 8;
+        const size_t beg = offset;
+        offset += size;
+        return beg;
+    };
+    header.ids_offset = place(n_docs * sizeof(std::uint64_t));
+    header.classes_offset = place(n_docs * sizeof(std::uint32_t));
+    header.doc_offsets_offset = place((n_docs + 1) * sizeof(std::uint64_t));
+    header.term_ids_offset = place(n_entries * sizeof(std::uint32_t));
+    header.counts_offset = place(n_entries * sizeof(std::uint32_t));
+    header.string_offsets_offset =
+        place(str_offsets.size() * sizeof(std::uint64_t));
+    header.string_data_offset = place(str_offsets.back());
+    header.file_size = offset;
+
+    // write the sections in order, padding the gaps with zeros
+    size_t written = 0;
+    auto write_at = [&os, &written](size_t beg, const void* data,
+                                    size_t size) {
+        static const char zeros[8] = {};
+        os.write(zeros, static_cast<std::streamsize>(beg - written));
+        os.write(static_cast<const char*>(data),
+                 static_cast<std::streamsize>(size));
+        written = beg + size;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.ids_offset, ids.data(), n_docs * sizeof(std::uint64_t));
+    write_at(header.classes_offset, classes.data(),
+             n_docs * sizeof(std::uint32_t));
+    write_at(header.doc_offsets_offset, doc_offsets.data(),
+             doc_offsets.size() * sizeof(std::uint64_t));
+    write_at(header.term_ids_offset, term_ids.data(),
+             n_entries * sizeof(std::uint32_t));
+    write_at(header.counts_offset, counts.data(),
+             n_entries * sizeof(std::uint32_t));
+    write_at(header.string_offsets_offset, str_offsets.data(),
+             str_offsets.size() * sizeof(std::uint64_t));
+    for (const term_id id : dict) {
+        const std::string& term = vocab.term(id);
+        write_at(written, term.data(), term.size());
+    }
+
+    os << std::flush;
+    return os;
+}
+
+bool ir::is_binary_dataset(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(BINARY_DATASET_MAGIC)] = {};
+    ifs.read(magic, sizeof(magic));
+
+    return ifs.gcount() == sizeof(magic) &&
+           std::memcmp(magic, BINARY_DATASET_MAGIC, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief Return the exception thrown when the compressed dataset in the given
+ * path is malformed.
+ *
+ * @param path Path to the compressed dataset file.
+ *
+ * @return Exception describing the error.
+ */
+static std::runtime_error invalid_compressed_dataset(const std::string& path) {
+    return std::runtime_error(path + " is not a valid compressed dataset file");
+}
+
+std::ostream& ir::write_compressed_dataset(std::ostream& os,
+                                           const id_term_index& term_index,
+                                           const doc_class_index& class_index,
+                                           const Vocabulary& vocab) {
+    // encoded bytes are written to os whenever the buffer grows this large
+    constexpr size_t buffer_size = 1 << 20;
+
+    // sorted dictionary of the terms occurring in the dataset
+    std::vector<bool> used(vocab.size(), false);
+    std::vector<term_id> dict;
+    for (const auto& pair : term_index) {
+        for (const auto& term_count_pair : pair.second) {
+            if (!used[term_count_pair.first]) {
+                used[term_count_pair.first] = true;
+                dict.push_back(term_count_pair.first);
+            }
+        }
+    }
+    std::sort(dict.begin(), dict.end(), [&vocab](term_id lhs, term_id rhs) {
+        return vocab.term(lhs) < vocab.term(rhs);
+    });
+    std::vector<std::uint32_t> dict_index(vocab.size());
+    for (size_t t = 0; t < dict.size(); ++t) {
+        dict_index[dict[t]] = static_cast<std::uint32_t>(t);
+    }
+
+    std::string out(COMPRESSED_DATASET_MAGIC, sizeof(COMPRESSED_DATASET_MAGIC));
+    append_varint(out, COMPRESSED_DATASET_VERSION);
+    append_varint(out, dict.size());
+    std::string_view prev;
+    for (const term_id id : dict) {
+        const std::string& term = vocab.term(id);
+        append_front_coded(out, prev, term);
+        prev = term;
+    }
+
+    append_varint(out, term_index.size());
+    std::vector<std::pair<std::uint32_t, size_t>> entries;
+    for (const auto& pair : term_index) {
+        entries.clear();
+        for (const auto& term_count_pair : pair.second) {
+            entries.emplace_back(dict_index[term_count_pair.first],
+                                 term_count_pair.second);
+        }
+        std::sort(entries.begin(), entries.end());
+
+        append_varint(out, pair.first);
+        append_varint(out,
+                      static_cast<std::uint64_t>(class_index.at(pair.first)));
+        append_varint(out, entries.size());
+        std::uint32_t prev_index = 0;
+        for (const auto& entry : entries) {
+            append_varint(out, entry.first - prev_index);
+            append_varint(out, entry.second);
+            prev_index = entry.first;
+        }
+
+        if (out.size() >= buffer_size) {
+            os.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    os.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+    os << std::flush;
+    return os;
+}
+
+bool ir::is_compressed_dataset(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(COMPRESSED_DATASET_MAGIC)] = {};
+    ifs.read(magic, sizeof(magic));
+
+    return ifs.gcount() == sizeof(magic) &&
+           std::memcmp(magic, COMPRESSED_DATASET_MAGIC, sizeof(magic)) == 0;
+}
+
+size_t ir::shard_of(size_t doc_id, size_t n_shards) {
+    // hash the little endian bytes of the id so that shards are the same on
+    // every host
+    char bytes[sizeof(std::uint64_t)];
+    std::uint64_t value = doc_id;
+    for (char& byte : bytes) {
+        byte = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+    return static_cast<size_t>(fnv1a_hash(bytes, sizeof(bytes)) % n_shards);
+}
+
+std::string ir::shard_path(const std::string& dataset_path, size_t shard) {
+    const size_t dir_end = dataset_path.rfind('/');
+    const size_t dot = dataset_path.rfind('.');
+    if (dot == std::string::npos ||
+        (dir_end != std::string::npos && dot < dir_end)) {
+        return dataset_path + '.' + std::to_string(shard);
+    }
+    return dataset_path.substr(0, dot) + '.' + std::to_string(shard) +
+           dataset_path.substr(dot);
+}
+
+std::ostream& ir::write_manifest(std::ostream& os,
+                                 const shard_manifest& manifest) {
+    os << MANIFEST_MAGIC << ' ' << MANIFEST_VERSION << '\n';
+    os << manifest.paths.size() << '\n';
+    for (size_t i = 0; i < manifest.paths.size(); ++i) {
+        os << manifest.n_docs[i] << ' ' << manifest.paths[i] << '\n';
+    }
+    return os;
+}
+
+ir::shard_manifest ir::read_manifest(const std::string& path) {
+    std::ifstream ifs(path);
+    if (!ifs) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    const auto invalid = [&path](const std::string& reason) {
+        return std::runtime_error(path + " is not a valid manifest file: " +
+                                  reason);
+    };
+
+    std::string magic;
+    std::uint32_t version;
+    size_t n_shards;
+    if (!(ifs >> magic >> version) || magic != MANIFEST_MAGIC) {
+        throw invalid("bad magic");
+    }
+    if (version != MANIFEST_VERSION) {
+        throw invalid("unsupported version " + std::to_string(version));
+    }
+    if (!(ifs >> n_shards)) {
+        throw invalid("missing number of shards");
+    }
+
+    // shard paths are relative to the directory of the manifest
+    const size_t dir_end = path.rfind('/');
+    const std::string dir =
+        dir_end == std::string::npos ? "" : path.substr(0, dir_end + 1);
+
+    shard_manifest manifest;
+    manifest.paths.reserve(n_shards);
+    manifest.n_docs.reserve(n_shards);
+    for (size_t i = 0; i < n_shards; ++i) {
+        size_t n_docs;
+        std::string shard;
+        if (!(ifs >> n_docs) || ifs.get() != ' ' ||
+            !std::getline(ifs, shard) || shard.empty()) {
+            throw invalid("missing shard " + std::to_string(i));
+        }
+        manifest.paths.push_back(shard.front() == '/' ? shard : dir + shard);
+        manifest.n_docs.push_back(n_docs);
+    }
+
+    return manifest;
+}
+
+bool ir::is_manifest(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    std::string magic(MANIFEST_MAGIC.size(), '\0');
+    ifs.read(&magic[0], static_cast<std::streamsize>(magic.size()));
+
+    return ifs.gcount() == static_cast<std::streamsize>(magic.size()) &&
+           magic == MANIFEST_MAGIC;
+}
+
+std::vector<std::string> ir::dataset_paths(const std::string& path) {
+    if (is_manifest(path)) {
+        return read_manifest(path).paths;
+    }
+    return {path};
+}
+
+ir::DatasetFile::DatasetFile(const std::string& path) : m_file(path) {
+    const auto invalid = [&path](const std::string& reason) {
+        return std::runtime_error(path +
+                                  " is not a valid binary dataset file: " +
+                                  reason);
+    };
+
+    if (m_file.size() < sizeof(binary_dataset_header)) {
+        throw invalid("file is too small");
+    }
+    m_header = section<binary_dataset_header>(0);
+    if (std::memcmp(m_header->magic, BINARY_DATASET_MAGIC,
+                    sizeof(BINARY_DATASET_MAGIC)) != 0) {
+        throw invalid("wrong magic bytes");
+    }
+    if (m_header->version != BINARY_DATASET_VERSION) {
+        throw invalid("unsupported version " +
+                      std::to_string(m_header->version));
+    }
+    if (m_header->byte_order != BYTE_ORDER_MARK) {
+        throw invalid("written with a different byte order");
+    }
+    if (m_header->file_size != m_file.size()) {
+        throw invalid("file is truncated");
+    }
+
+    // counts larger than the file cannot be valid; checking them first also
+    // keeps the section sizes below from overflowing
+    const std::uint64_t file_size = m_file.size();
+    const binary_dataset_header& h = *m_header;
+    if (h.n_docs >= file_size || h.n_entries > file_size ||
+        h.n_terms >= file_size) {
+        throw invalid("inconsistent header");
+    }
+
+    // a section of count elements of the given size must lie in the file
+    const auto fits = [file_size](std::uint64_t offset, std::uint64_t count,
+                                  std::uint64_t elem_size, std::uint64_t align) {
+        return offset % align == 0 && offset <= file_size &&
+               count <= (file_size - offset) / elem_size;
+    };
+    if (!fits(h.ids_offset, h.n_docs, sizeof(std::uint64_t),
+              alignof(std::uint64_t)) ||
+        !fits(h.classes_offset, h.n_docs, sizeof(std::uint32_t),
+              alignof(std::uint32_t)) ||
+        !fits(h.doc_offsets_offset, h.n_docs + 1, sizeof(std::uint64_t),
+              alignof(std::uint64_t)) ||
+        !fits(h.term_ids_offset, h.n_entries, sizeof(std::uint32_t),
+              alignof(std::uint32_t)) ||
+        !fits(h.counts_offset, h.n_entries, sizeof(std::uint32_t),
+              alignof(std::uint32_t)) ||
+        !fits(h.string_offsets_offset, h.n_terms + 1, sizeof(std::uint64_t),
+              alignof(std::uint64_t))) {
+        throw invalid("section out of bounds");
+    }
+
+    m_ids = section<std::uint64_t>(h.ids_offset);
+    m_classes = section<std::uint32_t>(h.classes_offset);
+    m_doc_offsets = section<std::uint64_t>(h.doc_offsets_offset);
+    m_term_ids = section<std::uint32_t>(h.term_ids_offset);
+    m_counts = section<std::uint32_t>(h.counts_offset);
+    m_str_offsets = section<std::uint64_t>(h.string_offsets_offset);
+    if (!fits(h.string_data_offset, m_str_offsets[h.n_terms], 1, 1)) {
+        throw invalid("section out of bounds");
+    }
+    m_str_data = section<char>(h.string_data_offset);
+
+    // entries and terms are read without bounds checks; hence, every offset
+    // and term id is checked once
+    if (m_doc_offsets[0] != 0 || m_doc_offsets[h.n_docs] != h.n_entries) {
+        throw invalid("document offsets do not cover the entries");
+    }
+    for (size_t doc = 0; doc < h.n_docs; ++doc) {
+        if (m_doc_offsets[doc] > m_doc_offsets[doc + 1]) {
+            throw invalid("document offsets are not sorted");
+        }
+    }
+    if (m_str_offsets[0] != 0) {
+        throw invalid("term offsets do not start at zero");
+    }
+    for (size_t term = 0; term < h.n_terms; ++term) {
+        if (m_str_offsets[term] > m_str_offsets[term + 1]) {
+            throw invalid("term offsets are not sorted");
+        }
+    }
+    for (size_t e = 0; e < h.n_entries; ++e) {
+        if (m_term_ids[e] >= h.n_terms) {
+            throw invalid("entry refers to a missing term");
+        }
+    }
+}
+
+size_t ir::DatasetFile::n_docs() const { return m_header->n_docs; }
+
+size_t ir::DatasetFile::n_terms() const { return m_header->n_terms; }
+
+size_t ir::DatasetFile::id(size_t doc) const { return m_ids[doc]; }
+
+ir::DocClass ir::DatasetFile::doc_class(size_t doc) const {
+    return static_cast<DocClass>(m_classes[doc]);
+}
+
+size_t ir::DatasetFile::doc_begin(size_t doc) const {
+    return m_doc_offsets[doc];
+}
+
+size_t ir::DatasetFile::doc_end(size_t doc) const {
+    return m_doc_offsets[doc + 1];
+}
+
+const std::uint32_t* ir::DatasetFile::term_ids() const { return m_term_ids; }
+
+const std::uint32_t* ir::DatasetFile::counts() const { return m_counts; }
+
+std::string ir::DatasetFile::term(size_t term) const {
+    return std::string(m_str_data + m_str_offsets[term],
+                       m_str_offsets[term + 1] - m_str_offsets[term]);
+}
+
+template <typename T>
+const T* ir::DatasetFile::section(std::uint64_t offset) const {
+    return reinterpret_cast<const T*>(m_file.data() + offset);
+}
+
+std::pair<ir::id_term_index, ir::doc_class_index>
+ir::read_dataset(const DatasetFile& dataset, Vocabulary& vocab) {
+    // intern every term of the dictionary only once
+    std::vector<term_id> ids(dataset.n_terms());
+    for (size_t t = 0; t < dataset.n_terms(); ++t) {
+        ids[t] = vocab.intern(dataset.term(t));
+    }
+
+    id_term_index docs;
+    doc_class_index classes;
+    docs.reserve(dataset.n_docs());
+    classes.reserve(dataset.n_docs());
+
+    const std::uint32_t* term_ids = dataset.term_ids();
+    const std::uint32_t* counts = dataset.counts();
+    for (size_t doc = 0; doc < dataset.n_docs(); ++doc) {
+        const size_t id = dataset.id(doc);
+        classes[id] = dataset.doc_class(doc);
+
+        auto& terms = docs[id];
+        terms.reserve(dataset.doc_end(doc) - dataset.doc_begin(doc));
+        for (size_t e = dataset.doc_begin(doc); e < dataset.doc_end(doc); ++e) {
+            terms[ids[term_ids[e]]] = counts[e];
+        }
+    }
+
+    return std::make_pair(docs, classes);
+}
+
+std::pair<ir::id_term_index, ir::doc_class_index>
+ir::load_dataset(const std::string& path, Vocabulary& vocab) {
+    if (is_binary_dataset(path)) {
+        return read_dataset(DatasetFile(path), vocab);
+    }
+
+    id_term_index docs;
+    doc_class_index classes;
+
+    DatasetReader reader(path, vocab);
+    dataset_doc doc;
+    while (reader.next(doc)) {
+        classes[doc.id] = doc.doc_class;
+        docs[doc.id] = std::move(doc.terms);
+    }
+
+    return std::make_pair(docs, classes);
+}
+
+ir::DatasetReader::iterator::iterator(DatasetReader* reader)
+    : m_reader(reader) {
+    ++*this;
+}
+
+ir::DatasetReader::iterator& ir::DatasetReader::iterator::operator++() {
+    if (m_reader != nullptr && !m_reader->next(m_doc)) {
+        m_reader = nullptr;
+    }
+    return *this;
+}
+
+ir::DatasetReader::DatasetReader(const std::string& path, Vocabulary& vocab)
+    : m_path(path), m_vocab(vocab) {
+    if (is_binary_dataset(path)) {
+        m_dataset.reset(new DatasetFile(path));
+        m_term_ids.reserve(m_dataset->n_terms());
+        for (size_t t = 0; t < m_dataset->n_terms(); ++t) {
+            m_term_ids.push_back(m_vocab.intern(m_dataset->term(t)));
+        }
+        return;
+    }
+
+    m_file.reset(new MappedFile(path));
+    m_pos = m_file->data();
+    m_end = m_pos + m_file->size();
+    if (m_file->size() < sizeof(COMPRESSED_DATASET_MAGIC) ||
+        std::memcmp(m_pos, COMPRESSED_DATASET_MAGIC,
+                    sizeof(COMPRESSED_DATASET_MAGIC)) != 0) {
+        return;
+    }
+
+    // skip the magic bytes, then intern the dictionary at once
+    m_compressed = true;
+    m_pos += sizeof(COMPRESSED_DATASET_MAGIC);
+    std::uint64_t version, n_terms;
+    if (!read_varint(m_pos, m_end, version) ||
+        version != COMPRESSED_DATASET_VERSION ||
+        !read_varint(m_pos, m_end, n_terms)) {
+        throw invalid_compressed_dataset(m_path);
+    }
+    std::string term;
+    for (std::uint64_t t = 0; t < n_terms; ++t) {
+        if (!read_front_coded(m_pos, m_end, term)) {
+            throw invalid_compressed_dataset(m_path);
+        }
+        m_term_ids.push_back(m_vocab.intern(term));
+    }
+    if (!read_varint(m_pos, m_end, m_docs_left)) {
+        throw invalid_compressed_dataset(m_path);
+    }
+}
+
+bool ir::DatasetReader::next(dataset_doc& doc) {
+    return next(doc.id, doc.doc_class, doc.terms);
+}
+
+bool ir::DatasetReader::next_batch(size_t batch_size, dataset_batch& batch) {
+    batch.ids.resize(batch_size);
+    batch.x.resize(batch_size);
+    batch.y.resize(batch_size);
+
+    size_t count = 0;
+    while (count < batch_size &&
+           next(batch.ids[count], batch.y[count], batch.x[count])) {
+        ++count;
+    }
+
+    batch.ids.resize(count);
+    batch.x.resize(count);
+    batch.y.resize(count);
+
+    return count != 0;
+}
+
+ir::DatasetReader::iterator ir::DatasetReader::begin() {
+    return iterator(this);
+}
+
+ir::DatasetReader::iterator ir::DatasetReader::end() { return iterator(); }
+
+bool ir::DatasetReader::next(size_t& id, DocClass& doc_class,
+                             id_sample& terms) {
+    if (m_compressed) {
+        return next_compressed(id, doc_class, terms);
+    }
+    if (!m_dataset) {
+        return next_text(id, doc_class, terms);
+    }
+
+    if (m_doc == m_dataset->n_docs()) {
+        return false;
+    }
+
+    id = m_dataset->id(m_doc);
+    doc_class = m_dataset->doc_class(m_doc);
+    terms.clear();
+    const std::uint32_t* term_ids = m_dataset->term_ids();
+    const std::uint32_t* counts = m_dataset->counts();
+    for (size_t e = m_dataset->doc_begin(m_doc); e < m_dataset->doc_end(m_doc);
+         ++e) {
+        terms[m_term_ids[term_ids[e]]] = counts[e];
+    }
+    ++m_doc;
+
+    return true;
+}
+
+bool ir::DatasetReader::next_text(size_t& id, DocClass& doc_class,
+                                  id_sample& terms) {
+    terms.clear();
+
+    bool found = false;
+    while (m_pos != m_end) {
+        const std::string_view line = next_line(m_pos, m_end);
+        ++m_line;
+
+        // empty line ends the document; skip the ones before it
+        if (line.empty()) {
+            if (found) {
+                break;
+            }
+            continue;
+        }
+
+        // split the line into its first two space separated fields
+        const size_t space = line.find(' ');
+        const std::string_view first = line.substr(0, space);
+        std::string_view second;
+        if (space != std::string_view::npos) {
+            second = line.substr(space + 1);
+            second = second.substr(0, second.find(' '));
+        }
+
+        if (!found) {
+            // read doc ID and class
+            if (!parse_size(first, id)) {
+                throw std::runtime_error(m_path + ':' + std::to_string(m_line) +
+                                         ": invalid document id");
+            }
+            doc_class = to_doc_class(second);
+            found = true;
+        } else {
+            // read word and its count
+            size_t count;
+            if (!parse_size(second, count)) {
+                throw std::runtime_error(m_path + ':' + std::to_string(m_line) +
+                                         ": invalid term count");
+            }
+            terms[m_vocab.intern(first)] = count;
+        }
+    }
+
+    return found;
+}
+
+bool ir::DatasetReader::next_compressed(size_t& id, DocClass& doc_class,
+                                        id_sample& terms) {
+    if (m_docs_left == 0) {
+        return false;
+    }
+
+    std::uint64_t doc_id, cls, n_entries;
+    if (!read_varint(m_pos, m_end, doc_id) || !read_varint(m_pos, m_end, cls) ||
+        !read_varint(m_pos, m_end, n_entries)) {
+        throw invalid_compressed_dataset(m_path);
+    }
+    id = doc_id;
+    doc_class = static_cast<DocClass>(cls);
+
+    // dictionary index of each entry is the sum of the gaps so far
+    terms.clear();
+    std::uint64_t index = 0;
+    for (std::uint64_t e = 0; e < n_entries; ++e) {
+        std::uint64_t gap, count;
+        if (!read_varint(m_pos, m_end, gap) ||
+            !read_varint(m_pos, m_end, count) ||
+            (index += gap) >= m_term_ids.size()) {
+            throw invalid_compressed_dataset(m_path);
+        }
+        terms[m_term_ids[index]] = count;
+    }
+    --m_docs_left;
+
+    return true;
+}
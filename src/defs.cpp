@@ -39,22 +39,25 @@ std::ostream& ir::operator<<(std::ostream& os, ir::DocClass doc_class) {
     return os;
 }
 
+ir::DocClass ir::to_doc_class(std::string_view str) {
+    if (str == "earn") {
+        return DocClass::Earn;
+    } else if (str == "acq") {
+        return DocClass::Acq;
+    } else if (str == "money-fx") {
+        return DocClass::MoneyFx;
+    } else if (str == "grain") {
+        return DocClass::Grain;
+    } else if (str == "crude") {
+        return DocClass::Crude;
+    }
+    return DocClass::Other;
+}
+
 std::istream& ir::operator>>(std::istream& is, DocClass& doc_class) {
     std::string class_str;
     is >> class_str;
-    if (class_str == "earn") {
-        doc_class = DocClass::Earn;
-    } else if (class_str == "acq") {
-        doc_class = DocClass::Acq;
-    } else if (class_str == "money-fx") {
-        doc_class = DocClass::MoneyFx;
-    } else if (class_str == "grain") {
-        doc_class = DocClass::Grain;
-    } else if (class_str == "crude") {
-        doc_class = DocClass::Crude;
-    } else {
-        doc_class = DocClass::Other;
-    }
+    doc_class = to_doc_class(class_str);
 
     return is;
 }
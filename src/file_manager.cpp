@@ -44,66 +44,199 @@ std::vector<std::string> ir::get_data_file_list() {
     return file_list;
 }
 
-std::ostream& ir::write_dataset(std::ostream& os,
-                                const doc_term_index& term_index,
-                                const doc_class_index& class_index) {
+/**
+ * @brief Write a single document to the given output stream in the format
+ * specified in ir::write_dataset.
+ *
+ * @tparam Sample Map type from a key of a term to its count.
+ * @tparam TermFunc Function type mapping a key of a document sample to its
+ * term.
+ *
+ * @param os Output stream object to write the document to.
+ * @param id ID of the document.
+ * @param doc_class Class of the document.
+ * @param doc Terms of the document and their counts.
+ * @param term_of Function returning the term of a sample key.
+ *
+ * @return Modified output stream.
+ */
+template <typename Sample, typename TermFunc>
+static std::ostream& write_document_impl(std::ostream& os, size_t id,
+                                         ir::DocClass doc_class,
+                                         const Sample& doc, TermFunc term_of) {
+    os << id << ' ' << doc_class << '\n';
+    for (const auto& term_count_pair : doc) {
+        const auto& term = term_of(term_count_pair.first);
+        const size_t count = term_count_pair.second;
+
+        os << term << ' ' << count << '\n';
+    }
+
+    return os << '\n';
+}
+
+/**
+ * @brief Write a dataset to the given output stream in the format specified in
+ * ir::write_dataset.
+ *
+ * @tparam TermIndex ir::doc_term_index or ir::id_term_index.
+ * @tparam TermFunc Function type mapping a key of a document sample to its
+ * term.
+ *
+ * @param os Output stream object to write the dataset to.
+ * @param term_index Mapping from document id to words and their counts.
+ * @param class_index Mapping from document id to class of the document.
+ * @param term_of Function returning the term of a sample key.
+ *
+ * @return Modified output stream.
+ */
+template <typename TermIndex, typename TermFunc>
+static std::ostream& write_dataset_impl(std::ostream& os,
+                                        const TermIndex& term_index,
+                                        const ir::doc_class_index& class_index,
+                                        TermFunc term_of) {
     for (const auto& pair : term_index) {
         const size_t id = pair.first;
         const auto& doc_terms_counts = pair.second;
         const auto& doc_class = class_index.at(id);
 
-        os << id << ' ' << doc_class << '\n';
-        for (const auto& term_count_pair : doc_terms_counts) {
-            const auto& term = term_count_pair.first;
-            const size_t count = term_count_pair.second;
-
-            os << term << ' ' << count << '\n';
-        }
-
-        os << '\n';
+        write_document_impl(os, id, doc_class, doc_terms_counts, term_of);
     }
     os << std::flush;
 
     return os;
 }
 
-std::pair<ir::doc_term_index, ir::doc_class_index>
-ir::read_dataset(std::istream& is){
-    ir::doc_term_index docs;
-    ir::doc_class_index classes;
+/**
+ * @brief Read the next document in the format specified in ir::write_dataset
+ * from the given input stream.
+ *
+ * @tparam Sample Map type from a key of a term to its count.
+ * @tparam KeyFunc Function type mapping a term to a key of a document sample.
+ *
+ * @param is Input stream from which the document will be read.
+ * @param id Reference to store the id of the document.
+ * @param doc_class Reference to store the class of the document.
+ * @param doc Reference to store the terms of the document and their counts.
+ * @param key_of Function returning the sample key of a read term.
+ *
+ * @return true if a document is read; false, if the stream ends before a
+ * document.
+ */
+template <typename Sample, typename KeyFunc>
+static bool read_document_impl(std::istream& is, size_t& id,
+                               ir::DocClass& doc_class, Sample& doc,
+                               KeyFunc key_of) {
+    doc.clear();
 
     std::string line;
-    std::stringstream ss;
-
-    size_t id;
-    ir::DocClass doc_class;
+    std::istringstream ss;
     std::string word;
     size_t count;
 
-    bool new_doc = true;
+    bool found = false;
     while (std::getline(is, line)) {
-        // empty line starts a new document
+        // empty line ends the document; skip the ones before it
         if (line.empty()) {
-            new_doc = true;
+            if (found) {
+                break;
+            }
             continue;
         }
         ss.str(line);
         ss.clear();
 
-        if (new_doc) {
+        if (!found) {
             // read doc ID and class
             ss >> id >> doc_class;
-            new_doc = false;
-
-            classes[id] = doc_class;
-            docs[id];
+            found = true;
         } else {
             // read word and its count
             ss >> word >> count;
 
-            docs[id][word] = count;
+            doc[key_of(word)] = count;
         }
     }
 
-   return std::make_pair(docs, classes);
-};
+    return found;
+}
+
+/**
+ * @brief Read a dataset in the format specified in ir::write_dataset from the
+ * given input stream.
+ *
+ * @tparam TermIndex ir::doc_term_index or ir::id_term_index.
+ * @tparam KeyFunc Function type mapping a term to a key of a document sample.
+ *
+ * @param is Input stream from which the dataset will be read.
+ * @param key_of Function returning the sample key of a read term.
+ *
+ * @return pair of TermIndex and ir::doc_class_index.
+ */
+template <typename TermIndex, typename KeyFunc>
+static std::pair<TermIndex, ir::doc_class_index>
+read_dataset_impl(std::istream& is, KeyFunc key_of) {
+    TermIndex docs;
+    ir::doc_class_index classes;
+
+    size_t id;
+    ir::DocClass doc_class;
+    typename TermIndex::mapped_type doc;
+    while (read_document_impl(is, id, doc_class, doc, key_of)) {
+        classes[id] = doc_class;
+        docs[id] = std::move(doc);
+    }
+
+    return std::make_pair(docs, classes);
+}
+
+std::ostream& ir::write_dataset(std::ostream& os,
+                                const doc_term_index& term_index,
+                                const doc_class_index& class_index) {
+    return write_dataset_impl(os, term_index, class_index,
+                              [](const std::string& term) -> const auto& {
+                                  return term;
+                              });
+}
+
+std::ostream& ir::write_dataset(std::ostream& os,
+                                const id_term_index& term_index,
+                                const doc_class_index& class_index,
+                                const Vocabulary& vocab) {
+    return write_dataset_impl(
+        os, term_index, class_index,
+        [&vocab](term_id id) -> const auto& { return vocab.term(id); });
+}
+
+std::ostream& ir::write_document(std::ostream& os, size_t id,
+                                 DocClass doc_class, const doc_sample& doc) {
+    return write_document_impl(os, id, doc_class, doc,
+                               [](const std::string& term) -> const auto& {
+                                   return term;
+                               });
+}
+
+std::pair<ir::doc_term_index, ir::doc_class_index>
+ir::read_dataset(std::istream& is) {
+    return read_dataset_impl<doc_term_index>(
+        is, [](const std::string& word) { return word; });
+}
+
+std::pair<ir::id_term_index, ir::doc_class_index>
+ir::read_dataset(std::istream& is, Vocabulary& vocab) {
+    return read_dataset_impl<id_term_index>(
+        is, [&vocab](const std::string& word) { return vocab.intern(word); });
+}
+
+bool ir::read_document(std::istream& is, size_t& id, DocClass& doc_class,
+                       doc_sample& doc) {
+    return read_document_impl(is, id, doc_class, doc,
+                              [](const std::string& word) { return word; });
+}
+
+bool ir::read_document(std::istream& is, Vocabulary& vocab, size_t& id,
+                       DocClass& doc_class, id_sample& doc) {
+    return read_document_impl(
+        is, id, doc_class, doc,
+        [&vocab](const std::string& word) { return vocab.intern(word); });
+}
@@ -14,13 +14,23 @@
  * limitations under the License.
  */
 
+#include "dataset_file.hpp"
 #include "feature_selection.hpp"
 #include "file_manager.hpp"
 #include "metrics.hpp"
+#include "model_io.hpp"
 #include "naive_bayes_classifier.hpp"
+#include "vocabulary.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 
 /**
  * @brief Fit argument string.
@@ -30,10 +40,101 @@ static const std::string FitArg = "--fit";
  * @brief Predict argument string.
  */
 static const std::string PredictArg = "--predict";
+/**
+ * @brief Update argument string.
+ */
+static const std::string UpdateArg = "--update";
+/**
+ * @brief Merge argument string.
+ */
+static const std::string MergeArg = "--merge";
+/**
+ * @brief Test set path that makes prediction read the test set from STDIN.
+ */
+static const std::string StdinPath = "-";
+/**
+ * @brief Number of documents read from a dataset at once when it is not kept
+ * in memory as a whole.
+ */
+static const size_t BatchSize = 4096;
 /**
  * @brief Number of features argument string.
  */
 static const std::string NumFeaturesArg = "--num-features";
+/**
+ * @brief Number of threads argument string.
+ */
+static const std::string ThreadsArg = "--threads";
+/**
+ * @brief Number of most probable classes argument string.
+ */
+static const std::string TopKArg = "--top-k";
+/**
+ * @brief Text model format argument string.
+ */
+static const std::string TextModelArg = "--text-model";
+/**
+ * @brief Compressed model format argument string.
+ */
+static const std::string CompressedModelArg = "--compressed-model";
+
+/**
+ * @brief Format of a model file.
+ */
+enum class ModelFormat {
+    /**
+     * @brief Memory mappable binary format written by ir::write_binary_model.
+     */
+    Binary,
+    /**
+     * @brief Text format written by ir::write_model.
+     */
+    Text,
+    /**
+     * @brief Compressed format written by ir::write_compressed_model.
+     */
+    Compressed
+};
+
+/**
+ * @brief Arguments of the classifier program.
+ */
+struct ProgramArgs {
+    /**
+     * @brief Main option (FitArg, PredictArg, UpdateArg or MergeArg).
+     */
+    std::string option;
+    /**
+     * @brief Path to the training set, the test set or the additional
+     * training set.
+     */
+    std::string data_path;
+    /**
+     * @brief Path to the model file.
+     */
+    std::string model_path;
+    /**
+     * @brief Paths to the model files to merge.
+     */
+    std::vector<std::string> input_paths;
+    /**
+     * @brief Number of features to use during training (0 means all).
+     */
+    size_t num_features = 0;
+    /**
+     * @brief Number of threads to use.
+     */
+    size_t num_threads = 1;
+    /**
+     * @brief Number of most probable classes to output with their posterior
+     * probabilities during prediction (0 means none).
+     */
+    size_t top_k = 0;
+    /**
+     * @brief Format to save the fitted or merged model in.
+     */
+    ModelFormat model_format = ModelFormat::Binary;
+};
 
 /**
  * @brief Output count many space characters to the given output stream.
@@ -57,16 +158,30 @@ void print_usage(char* program_name) {
     std::string header("usage: ");
     std::string param_fit(FitArg + " train_set model_path");
     std::string param_predict(PredictArg + " test_set model_path");
+    std::string param_update(UpdateArg + " train_delta model_path");
+    std::string param_merge(MergeArg + " model_path in_model...");
     std::string param_num_features(NumFeaturesArg + " N");
+    std::string param_threads(ThreadsArg + " N");
+    std::string param_top_k(TopKArg + " K");
 
-    size_t max_param_len = std::max(param_fit.size(), param_predict.size());
+    size_t max_param_len = std::max(
+        {param_fit.size(), param_predict.size(), param_update.size()});
 
     header += std::string(program_name) + ' ';
     std::cerr << header << '[' << param_fit << " [" << param_num_features << ']'
-              << ']' << '\n';
+              << " [" << param_threads << ']' << " [" << TextModelArg << " | "
+              << CompressedModelArg << ']' << ']' << '\n';
+
+    print_space(std::cerr, header.size());
+    std::cerr << '[' << param_predict << " [" << param_threads << ']' << " ["
+              << param_top_k << ']' << ']' << '\n';
 
     print_space(std::cerr, header.size());
-    std::cerr << '[' << param_predict << ']' << '\n';
+    std::cerr << '[' << param_update << ']' << '\n';
+
+    print_space(std::cerr, header.size());
+    std::cerr << '[' << param_merge << " [" << TextModelArg << " | "
+              << CompressedModelArg << ']' << ']' << '\n';
 
     std::cerr << '\n';
     std::cerr
@@ -79,7 +194,11 @@ void print_usage(char* program_name) {
     std::cerr << "  " << param_fit << '\t'
               << " Fit a Naive Bayes classifier from given\n";
     print_space(std::cerr, max_param_len + 4);
-    std::cerr << "train_set and save the model to model_path." << '\n';
+    std::cerr << "train_set and save the model to model_path.\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "If train_set is a shard manifest, its shards\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "are fitted concurrently and merged." << '\n';
 
     std::cerr << '\n';
 
@@ -92,81 +211,352 @@ void print_usage(char* program_name) {
 
     std::cerr << '\n';
 
+    std::cerr << "  " << TextModelArg << "\t\t"
+              << " Save the fitted or merged model in the text\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "format instead of the memory mappable binary\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "format.\n";
+
+    std::cerr << '\n';
+
+    std::cerr << "  " << CompressedModelArg << '\t'
+              << " Save the fitted or merged model in the\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "compact varint encoded format instead of the\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "memory mappable binary format.\n";
+
+    std::cerr << '\n';
+
     std::cerr << "  " << param_predict << '\t'
               << " Predict the classes of samples in test_set\n";
     print_space(std::cerr, max_param_len + 4);
     std::cerr << "using an already fitted model in model_path\n";
     print_space(std::cerr, max_param_len + 4);
-    std::cerr << "and output the results to STDOUT." << '\n';
+    std::cerr << "and output the results to STDOUT. Model format\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "(binary, compressed or text) is detected\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "automatically.\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "If test_set is " << StdinPath
+              << ", samples are read from STDIN and\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "each prediction is output as soon as its\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "sample is read.\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "If test_set is a shard manifest, its shards\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "are predicted concurrently." << '\n';
+
+    std::cerr << '\n';
+
+    std::cerr << "  " << param_update << ' '
+              << " Update an already fitted model in model_path\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "with the additional samples in train_delta\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "and save it back in the same format." << '\n';
+
+    std::cerr << '\n';
+
+    std::cerr << "  " << param_merge << ' '
+              << " Merge the models fitted on separate parts of\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "a training set and save the result to\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "model_path." << '\n';
+
+    std::cerr << '\n';
+
+    std::cerr << "  " << param_top_k << "\t\t"
+              << " Output the K most probable classes of each\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "test sample with their posterior probabilities\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "after its predicted class." << '\n';
+
+    std::cerr << '\n';
+
+    std::cerr << "  " << param_threads << "\t\t"
+              << " Number of threads to use during training or\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "prediction.\n";
+    print_space(std::cerr, max_param_len + 4);
+    std::cerr << "If 0, all hardware threads are used. Default is 1.\n";
 
     std::cerr << std::flush;
 }
 
 /**
- * @brief Check if the program arguments are given correctly.
+ * @brief Parse the program arguments and check if they are given correctly.
  *
  * @param argc Number of arguments as given in int main(int argc, char** argv).
  * @param argv Argument string array as given in int main(int argc, char**
  * argv).
+ * @param args ProgramArgs object to store the parsed arguments.
  *
  * @return true if the given arguments are correct; false, otherwise.
  */
-bool correct_args(int argc, char** argv) {
-    if (!(argc == 4 || argc == 6)) {
+bool parse_args(int argc, char** argv, ProgramArgs& args) {
+    // main option, at least two paths and optional arguments
+    if (argc < 4) {
         return false;
     }
-    std::string option(argv[1]);
-    bool correct_option = option == FitArg || option == PredictArg;
-    if (argc == 4) {
-        return correct_option;
+    args.option = argv[1];
+    if (!(args.option == FitArg || args.option == PredictArg ||
+          args.option == UpdateArg || args.option == MergeArg)) {
+        return false;
+    }
+
+    int i = 2;
+    if (args.option == MergeArg) {
+        // output model followed by every input model until the first option
+        args.model_path = argv[i++];
+        while (i < argc && std::string(argv[i]).compare(0, 2, "--") != 0) {
+            args.input_paths.emplace_back(argv[i++]);
+        }
+        if (args.input_paths.empty()) {
+            return false;
+        }
+    } else {
+        args.data_path = argv[i++];
+        args.model_path = argv[i++];
+    }
+
+    for (; i < argc; ++i) {
+        std::string name(argv[i]);
+        if ((name == TextModelArg || name == CompressedModelArg) &&
+            (args.option == FitArg || args.option == MergeArg)) {
+            args.model_format = name == TextModelArg ? ModelFormat::Text
+                                                     : ModelFormat::Compressed;
+            continue;
+        }
+
+        // remaining optional arguments take a numeric value
+        if (++i == argc) {
+            return false;
+        }
+        std::string value(argv[i]);
+        bool only_digits = !value.empty() &&
+                           value.find_first_not_of("0123456789") ==
+                               std::string::npos;
+        if (!only_digits) {
+            return false;
+        }
+
+        if (name == NumFeaturesArg && args.option == FitArg) {
+            args.num_features = std::stoul(value);
+        } else if (name == TopKArg && args.option == PredictArg) {
+            args.top_k = std::stoul(value);
+        } else if (name == ThreadsArg &&
+                   (args.option == FitArg || args.option == PredictArg)) {
+            args.num_threads = std::stoul(value);
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Return the format of the model file in the given path.
+ *
+ * @param path Path to a model file.
+ *
+ * @return Format of the model file.
+ */
+ModelFormat model_format(const std::string& path) {
+    if (ir::is_binary_model(path)) {
+        return ModelFormat::Binary;
+    } else if (ir::is_compressed_model(path)) {
+        return ModelFormat::Compressed;
+    }
+    return ModelFormat::Text;
+}
+
+/**
+ * @brief Load the model file in the given path in any format to the given
+ * classifier and intern its words to the given vocabulary.
+ *
+ * @param path Path to a model file.
+ * @param clf Classifier to assign the read model.
+ * @param vocab Vocabulary to intern the words of the model.
+ * @param pool Thread pool to parse a text model on.
+ */
+void load_model(const std::string& path,
+                ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>& clf,
+                ir::Vocabulary& vocab, ir::ThreadPool& pool) {
+    switch (model_format(path)) {
+    case ModelFormat::Binary: {
+        const ir::ModelFile<ir::DocClass> model(path);
+        ir::read_binary_model(model, clf, vocab);
+        break;
+    }
+    case ModelFormat::Compressed:
+        ir::load_compressed_model(path, clf, vocab);
+        break;
+    case ModelFormat::Text:
+        ir::load_text_model(path, clf, vocab, pool);
+        break;
     }
+}
 
-    std::string num_features_option(argv[4]);
-    std::string num_features(argv[5]);
-    correct_option = option == FitArg && num_features_option == NumFeaturesArg;
-    bool only_digits =
-        num_features.find_first_not_of("0123456789") == std::string::npos;
+/**
+ * @brief Save the given classifier to the given path in the given format.
+ *
+ * @param path Path to which the model is going to be saved.
+ * @param clf Classifier to save.
+ * @param vocab Vocabulary that assigned the ids of the words of clf.
+ * @param format Format to save the model in.
+ */
+void save_model(const std::string& path,
+                const ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>& clf,
+                const ir::Vocabulary& vocab, ModelFormat format) {
+    switch (format) {
+    case ModelFormat::Binary: {
+        std::ofstream model_file(path, std::ios::binary);
+        ir::write_binary_model(model_file, clf, vocab);
+        break;
+    }
+    case ModelFormat::Compressed: {
+        std::ofstream model_file(path, std::ios::binary);
+        ir::write_compressed_model(model_file, clf, vocab);
+        break;
+    }
+    case ModelFormat::Text: {
+        std::ofstream model_file(path);
+        ir::write_model(model_file, clf, vocab);
+        break;
+    }
+    }
+}
 
-    return correct_option && only_digits;
+/**
+ * @brief Return a copy of the given classifier whose words are interned to
+ * another vocabulary.
+ *
+ * @param clf Classifier whose words are ids assigned by from.
+ * @param from Vocabulary that assigned the ids of the words of clf.
+ * @param to Vocabulary to intern the words of the returned classifier.
+ *
+ * @return Classifier with the same counts as clf whose words are ids
+ * assigned by to.
+ */
+ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>
+remap_words(const ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>& clf,
+            const ir::Vocabulary& from, ir::Vocabulary& to) {
+    using classifier_t = ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>;
+    classifier_t::prior_t prior = clf.prior();
+    classifier_t::likelihood_t likelihood;
+    likelihood.reserve(clf.likelihood().size());
+    for (const auto& pair : clf.likelihood()) {
+        likelihood.emplace(to.intern(from.term(pair.first)), pair.second);
+    }
+    return classifier_t(std::move(prior), std::move(likelihood));
+}
+
+/**
+ * @brief Fit a Naive Bayes Classifier on every shard in the given paths
+ * concurrently and merge them into a single classifier.
+ *
+ * Each shard is read and counted by a single thread of the given pool with its
+ * own vocabulary; hence, shards are processed without any synchronization.
+ * Shard classifiers are then interned to the given vocabulary and merged in
+ * the given order. The result is the same as fitting on the concatenation of
+ * the shards.
+ *
+ * @param shard_paths Paths to the shards of a training set.
+ * @param vocab Vocabulary to intern the words of the merged classifier.
+ * @param pool ThreadPool whose threads will fit the shards.
+ *
+ * @return Classifier fitted on all the shards.
+ */
+ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>
+fit_shards(const std::vector<std::string>& shard_paths, ir::Vocabulary& vocab,
+           ir::ThreadPool& pool) {
+    const size_t n_shards = shard_paths.size();
+    std::vector<ir::Vocabulary> shard_vocabs(n_shards);
+    std::vector<ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>> shard_clfs(
+        n_shards);
+    pool.parallel_for(n_shards, 1, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            ir::DatasetReader reader(shard_paths[i], shard_vocabs[i]);
+            ir::dataset_batch batch;
+            while (reader.next_batch(BatchSize, batch)) {
+                shard_clfs[i].partial_fit(batch.x, batch.y);
+            }
+        }
+    });
+
+    ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> clf;
+    for (size_t i = 0; i < n_shards; ++i) {
+        clf.merge(remap_words(shard_clfs[i], shard_vocabs[i], vocab));
+        // release the shard as soon as it is merged
+        shard_clfs[i] = ir::NaiveBayesClassifier<ir::term_id, ir::DocClass>();
+        shard_vocabs[i] = ir::Vocabulary();
+    }
+    return clf;
 }
 
 /**
  * @brief Fit a Naive Bayes Classifier with the given number of features.
  *
  * This function trains a Naive Bayes Classifier from the given training set
- * and saves the model to the given output path.
+ * and saves the model to the given output path. If the training set is a
+ * shard manifest (see ir::read_manifest) and every word is a feature, the
+ * shards are fitted concurrently by fit_shards; if features are selected, the
+ * shards are read one after another since feature selection needs the whole
+ * training set.
  *
- * @param train_path Path to the training set.
+ * @param train_path Path to the training set or its shard manifest.
  * @param model_path Path to which the model is going to be saved.
  * @param num_features Number of features to use. If not given, all the features
  * are used.
+ * @param num_threads Number of threads to use during training.
+ * @param format Format to save the model in.
  */
 void fit(const std::string& train_path, const std::string& model_path,
-         size_t num_features = 0) {
-    ir::doc_term_index doc_terms;
-    ir::doc_class_index doc_classes;
-    {
-        std::ifstream train_file(train_path);
-        std::tie(doc_terms, doc_classes) = ir::read_dataset(train_file);
-    }
-
-    // construct training set feature (x) and label (y) sets, and a set of
-    // classes.
-    std::vector<ir::doc_sample> x_train;
-    std::vector<ir::DocClass> y_train;
-    std::set<ir::DocClass> class_dict;
-    for (const auto& pair : doc_terms) {
-        const size_t id = pair.first;
-        const ir::doc_sample& doc = pair.second;
-        const ir::DocClass& doc_class = doc_classes[id];
-
-        x_train.push_back(doc);
-        y_train.push_back(doc_class);
-        class_dict.insert(doc_class);
-    }
-
-    // choose important words via mutual information if num_features is given
-    if (num_features != 0) {
+         size_t num_features = 0, size_t num_threads = 1,
+         ModelFormat format = ModelFormat::Binary) {
+    ir::Vocabulary vocab;
+    ir::ThreadPool pool(num_threads);
+    ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> clf;
+    const auto train_paths = ir::dataset_paths(train_path);
+
+    if (num_features == 0 && train_paths.size() > 1) {
+        clf = fit_shards(train_paths, vocab, pool);
+    } else if (num_features == 0) {
+        // every word is a feature; hence, training set is counted in batches
+        // and never kept in memory as a whole. Merging only adds the counts
+        // of a batch, and the tables are built once when the model is saved
+        ir::DatasetReader reader(train_paths.front(), vocab);
+        ir::dataset_batch batch;
+        while (reader.next_batch(BatchSize, batch)) {
+            ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> part;
+            part.fit(batch.x, batch.y, pool);
+            clf.merge(part);
+        }
+    } else {
+        // construct training set feature (x) and label (y) sets, and a set of
+        // classes.
+        std::vector<ir::id_sample> x_train;
+        std::vector<ir::DocClass> y_train;
+        std::set<ir::DocClass> class_dict;
+        ir::dataset_doc doc;
+        for (const auto& path : train_paths) {
+            ir::DatasetReader reader(path, vocab);
+            while (reader.next(doc)) {
+                x_train.push_back(std::move(doc.terms));
+                y_train.push_back(doc.doc_class);
+                class_dict.insert(doc.doc_class);
+            }
+        }
+
+        // choose important words via mutual information
         // get most important words found by mutual info
         auto top_words_per_class = ir::get_top_words_per_class(
             x_train, y_train, class_dict, num_features);
@@ -180,7 +570,7 @@ void fit(const std::string& train_path, const std::string& model_path,
             for (size_t i = 0; i < cls_str.size(); ++i) std::cerr << '-';
             std::cerr << std::endl;
             for (const auto& word : word_vec) {
-                std::cerr << word << std::endl;
+                std::cerr << vocab.term(word) << std::endl;
             }
             std::cerr << std::endl;
         }
@@ -193,15 +583,13 @@ void fit(const std::string& train_path, const std::string& model_path,
 
         // remove unimportant words
         ir::remove_unimportant_words(x_train, y_train, top_words_per_class);
-    }
 
-    // fit naive bayes clf
-    ir::NaiveBayesClassifier<std::string, ir::DocClass> clf;
-    clf.fit(x_train, y_train);
+        // fit naive bayes clf
+        clf.fit(x_train, y_train, pool);
+    }
 
     // save the classifier
-    std::ofstream model_file(model_path);
-    model_file << clf;
+    save_model(model_path, clf, vocab, format);
 }
 
 template <typename LeftVal, typename RightVal>
@@ -269,59 +657,422 @@ void print_prediction_stats(const std::vector<ir::DocClass>& y_test,
     }
 }
 
+/**
+ * @brief Most probable classes of a sample and their posterior probabilities.
+ */
+using top_classes = std::vector<std::pair<ir::DocClass, double>>;
+
+/**
+ * @brief Output the test and predicted classes of a sample followed by its
+ * most probable classes to the given output stream.
+ *
+ * @param os Output stream.
+ * @param id ID of the sample.
+ * @param test Actual class of the sample.
+ * @param pred Predicted class of the sample.
+ * @param top Most probable classes of the sample (may be empty).
+ */
+void print_prediction(std::ostream& os, size_t id, ir::DocClass test,
+                      ir::DocClass pred, const top_classes& top) {
+    os << "ID: " << std::setw(5) << std::right << id << " | "
+       << "Test: " << std::setw(10) << std::right << test << " | "
+       << "Pred: " << std::setw(10) << std::right << pred;
+    for (const auto& pair : top) {
+        os << " | " << pair.first << ' ' << pair.second;
+    }
+    os << '\n';
+}
+
+/**
+ * @brief Return the predicted class of a sample from its class scores and
+ * compute its most probable classes if requested.
+ *
+ * @param scores Unnormalized log posterior of each class of the sample.
+ * @param classes Classes of the model in the order of scores.
+ * @param top_k Number of most probable classes to compute (0 means none).
+ * @param proba Buffer to compute the posterior probabilities in.
+ * @param top Reference to store the most probable classes of the sample.
+ *
+ * @return Predicted class of the sample.
+ */
+ir::DocClass classify_scores(const double* scores,
+                             const std::vector<ir::DocClass>& classes,
+                             size_t top_k, std::vector<double>& proba,
+                             top_classes& top) {
+    top.clear();
+    if (top_k == 0) {
+        return classes[ir::best_score(scores, classes.size())];
+    }
+
+    proba.assign(scores, scores + classes.size());
+    ir::normalize_log_proba(proba.data(), proba.size());
+    for (double& value : proba) {
+        value = std::exp(value);
+    }
+    for (size_t index : ir::top_k_scores(proba.data(), proba.size(), top_k)) {
+        top.emplace_back(classes[index], proba[index]);
+    }
+    return top.front().first;
+}
+
+/**
+ * @brief Predictions of the documents of a single test set shard.
+ */
+struct shard_predictions {
+    /**
+     * @brief Formatted predictions as output by print_prediction.
+     */
+    std::string output;
+    /**
+     * @brief Actual class of each document.
+     */
+    std::vector<ir::DocClass> y_test;
+    /**
+     * @brief Predicted class of each document.
+     */
+    std::vector<ir::DocClass> y_pred;
+};
+
+/**
+ * @brief Predict the classes of the documents of every shard in the given
+ * paths concurrently, then output the results to STDOUT in shard order.
+ *
+ * Each shard is read and scored by a single thread of the given pool with its
+ * own vocabulary. Words of a shard are mapped to their table rows once, when
+ * they are read for the first time, using the given row_of function. The
+ * predictions of a shard are buffered until all the shards before it are
+ * output.
+ *
+ * @tparam RowFunc Function type mapping a word to its table row.
+ *
+ * @param shard_paths Paths to the shards of a test set.
+ * @param table Log-probability tables of the model.
+ * @param classes Classes of the model in the column order of table.
+ * @param row_of Function returning the table row of a word, or the row of
+ * unseen words if the word is not in the model. Called concurrently.
+ * @param top_k Number of most probable classes to output for each sample.
+ * @param pool ThreadPool whose threads will predict the shards.
+ */
+template <typename RowFunc>
+void predict_shards(const std::vector<std::string>& shard_paths,
+                    const ir::log_prob_table& table,
+                    const std::vector<ir::DocClass>& classes, RowFunc row_of,
+                    size_t top_k, ir::ThreadPool& pool) {
+    std::vector<shard_predictions> results(shard_paths.size());
+    pool.parallel_for(shard_paths.size(), 1, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            auto& result = results[i];
+            ir::Vocabulary vocab;
+            std::vector<std::uint32_t> rows;
+            std::vector<double> proba;
+            top_classes top;
+            std::ostringstream os;
+
+            ir::DatasetReader reader(shard_paths[i], vocab);
+            ir::dataset_batch batch;
+            while (reader.next_batch(BatchSize, batch)) {
+                // look up only the terms seen for the first time in this batch
+                for (size_t id = rows.size(); id < vocab.size(); ++id) {
+                    rows.push_back(static_cast<std::uint32_t>(
+                        row_of(vocab.term(static_cast<ir::term_id>(id)))));
+                }
+                ir::score_samples(
+                    table, batch.x, 0, batch.size(),
+                    [&rows](ir::term_id id) { return rows[id]; },
+                    [&](size_t j, const double* scores) {
+                        const auto pred =
+                            classify_scores(scores, classes, top_k, proba, top);
+                        print_prediction(os, batch.ids[j], batch.y[j], pred,
+                                         top);
+                        result.y_pred.push_back(pred);
+                    });
+                result.y_test.insert(result.y_test.end(), batch.y.begin(),
+                                     batch.y.end());
+            }
+            result.output = os.str();
+        }
+    });
+
+    std::vector<ir::DocClass> y_test;
+    std::vector<ir::DocClass> y_pred;
+    for (auto& result : results) {
+        std::cout << result.output;
+        y_test.insert(y_test.end(), result.y_test.begin(), result.y_test.end());
+        y_pred.insert(y_pred.end(), result.y_pred.begin(), result.y_pred.end());
+        result = shard_predictions();
+    }
+    std::cout << std::flush;
+
+    print_prediction_stats(y_test, y_pred);
+}
+
 /**
  * @brief Predict the classes of all samples in the given test set and output
  * the results to STDOUT.
  *
- * @param test_path Path to the test set.
+ * Test set is read and predicted in batches of BatchSize documents; hence,
+ * only the labels of the whole test set are kept in memory to compute the
+ * metrics.
+ *
+ * If the test set is a shard manifest (see ir::read_manifest), the shards are
+ * predicted concurrently by predict_shards instead.
+ *
+ * @param test_path Path to the test set or its shard manifest.
  * @param model_path Path to an already fitted model file.
+ * @param num_threads Number of threads to use during prediction.
+ * @param top_k Number of most probable classes to output for each sample. If
+ * 0, only the predicted classes are output.
  */
-void predict(const std::string& test_path, const std::string& model_path) {
-    // read the classifier
-    ir::NaiveBayesClassifier<std::string, ir::DocClass> clf;
-    {
-        std::ifstream model_file(model_path);
-        model_file >> clf;
+void predict(const std::string& test_path, const std::string& model_path,
+             size_t num_threads = 1, size_t top_k = 0) {
+    ir::ThreadPool pool(num_threads);
+    ir::Vocabulary vocab;
+
+    // load the model; a binary model is used directly from the mapped file
+    std::unique_ptr<ir::ModelFile<ir::DocClass>> model;
+    ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> clf;
+    if (ir::is_binary_model(model_path)) {
+        model.reset(new ir::ModelFile<ir::DocClass>(model_path));
+    } else {
+        load_model(model_path, clf, vocab, pool);
     }
 
-    // read test set
-    ir::doc_term_index doc_terms;
-    ir::doc_class_index doc_classes;
-    {
-        std::ifstream test_file(test_path);
-        std::tie(doc_terms, doc_classes) = ir::read_dataset(test_file);
+    if (ir::is_manifest(test_path)) {
+        const auto shard_paths = ir::read_manifest(test_path).paths;
+        if (model) {
+            predict_shards(shard_paths, model->table(), model->classes(),
+                           [&model](const std::string& word) {
+                               return model->find(word);
+                           },
+                           top_k, pool);
+        } else {
+            predict_shards(shard_paths, clf.table(), clf.classes(),
+                           [&clf, &vocab](const std::string& word) {
+                               return clf.row_of(vocab.find(word));
+                           },
+                           top_k, pool);
+        }
+        return;
     }
 
-    // construct test features (x) and labels (y)
-    std::vector<size_t> id_vec;
-    std::vector<ir::doc_sample> x_test;
+    // predict the test set in batches, computing the posteriors in the same
+    // pass over the model if the most probable classes are requested
     std::vector<ir::DocClass> y_test;
-    for (const auto& pair : doc_terms) {
-        const size_t id = pair.first;
-        const ir::doc_sample& doc = pair.second;
-        const ir::DocClass& doc_class = doc_classes[id];
-
-        id_vec.push_back(id);
-        x_test.push_back(doc);
-        y_test.push_back(doc_class);
-    }
+    std::vector<ir::DocClass> y_pred;
+    std::vector<std::uint32_t> rows;
+    std::vector<ir::DocClass> batch_pred;
+    std::vector<top_classes> batch_top;
+    ir::DatasetReader reader(test_path, vocab);
+    ir::dataset_batch batch;
+    while (reader.next_batch(BatchSize, batch)) {
+        if (model) {
+            // look up only the terms seen for the first time in this batch
+            for (size_t id = rows.size(); id < vocab.size(); ++id) {
+                rows.push_back(static_cast<std::uint32_t>(
+                    model->find(vocab.term(static_cast<ir::term_id>(id)))));
+            }
+            if (top_k != 0) {
+                batch_top = model->predict_top_k(batch.x, rows, top_k, pool);
+            } else {
+                batch_pred = model->predict(batch.x, rows, pool);
+            }
+        } else {
+            if (top_k != 0) {
+                batch_top = clf.predict_top_k(batch.x, top_k, pool);
+            } else {
+                batch_pred = clf.predict(batch.x, pool);
+            }
+        }
 
-    // predict test features
-    const auto y_pred = clf.predict(x_test);
+        // most probable class is the predicted class
+        if (top_k != 0) {
+            batch_pred.clear();
+            for (const auto& top : batch_top) {
+                batch_pred.push_back(top.front().first);
+            }
+        } else {
+            batch_top.assign(batch_pred.size(), top_classes());
+        }
 
-    // output test and prediction labels
-    for (size_t i = 0; i < id_vec.size(); ++i) {
-        std::cout << "ID: " << std::setw(5) << std::right << id_vec[i] << " | "
-                  << "Test: " << std::setw(10) << std::right << y_test[i]
-                  << " | "
-                  << "Pred: " << std::setw(10) << std::right << y_pred[i]
-                  << '\n';
+        // output test and prediction labels
+        for (size_t i = 0; i < batch.size(); ++i) {
+            print_prediction(std::cout, batch.ids[i], batch.y[i],
+                             batch_pred[i], batch_top[i]);
+        }
+        y_test.insert(y_test.end(), batch.y.begin(), batch.y.end());
+        y_pred.insert(y_pred.end(), batch_pred.begin(), batch_pred.end());
     }
     std::cout << std::flush;
 
     print_prediction_stats(y_test, y_pred);
 }
 
+/**
+ * @brief Predict the class of every document in the given input stream as soon
+ * as it is read and output the result to the given output stream.
+ *
+ * Only a single document is kept in memory at a time.
+ *
+ * @tparam RowFunc Function type mapping a word to its table row.
+ *
+ * @param is Input stream containing documents in the dataset format.
+ * @param os Output stream to write the predictions to.
+ * @param table Log-probability tables of the model.
+ * @param classes Classes of the model in the column order of table.
+ * @param row_of Function returning the table row of a word, or the row of
+ * unseen words if the word is not in the model.
+ * @param top_k Number of most probable classes to output for each document.
+ */
+template <typename RowFunc>
+void stream_predictions(std::istream& is, std::ostream& os,
+                        const ir::log_prob_table& table,
+                        const std::vector<ir::DocClass>& classes,
+                        RowFunc row_of, size_t top_k) {
+    size_t id;
+    ir::DocClass doc_class;
+    std::vector<ir::doc_sample> x(1);
+    std::vector<double> proba;
+    top_classes top;
+    while (ir::read_document(is, id, doc_class, x[0])) {
+        ir::score_samples(
+            table, x, 0, 1, row_of, [&](size_t, const double* scores) {
+                const auto pred =
+                    classify_scores(scores, classes, top_k, proba, top);
+                print_prediction(os, id, doc_class, pred, top);
+            });
+        os << std::flush;
+    }
+}
+
+/**
+ * @brief Predict the classes of the documents read from STDIN and output each
+ * result to STDOUT as soon as its document is read.
+ *
+ * The model is loaded only once, and memory usage does not grow with the
+ * number of documents; hence, this mode can serve a continuous feed of
+ * documents. Words that are not in the model are scored as unseen words
+ * without being added to any dictionary.
+ *
+ * @param model_path Path to an already fitted model file.
+ * @param top_k Number of most probable classes to output for each document.
+ * If 0, only the predicted classes are output.
+ */
+void predict_stream(const std::string& model_path, size_t top_k = 0) {
+    // read STDIN in large chunks instead of character by character
+    std::ios::sync_with_stdio(false);
+
+    if (ir::is_binary_model(model_path)) {
+        const ir::ModelFile<ir::DocClass> model(model_path);
+        stream_predictions(std::cin, std::cout, model.table(), model.classes(),
+                           [&model](const std::string& word) {
+                               return model.find(word);
+                           },
+                           top_k);
+    } else {
+        ir::Vocabulary vocab;
+        ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> clf;
+        ir::ThreadPool pool;
+        load_model(model_path, clf, vocab, pool);
+        stream_predictions(std::cin, std::cout, clf.table(), clf.classes(),
+                           [&clf, &vocab](const std::string& word) {
+                               return clf.row_of(vocab.find(word));
+                           },
+                           top_k);
+    }
+}
+
+/**
+ * @brief Update an already fitted model with the samples in the given
+ * additional training set and save it back to the same path.
+ *
+ * The model is updated incrementally using
+ * ir::NaiveBayesClassifier::partial_fit; hence, the samples it was previously
+ * fitted with are not needed. Model is saved in the format it is read.
+ *
+ * @param delta_path Path to the additional training set.
+ * @param model_path Path to an already fitted model file.
+ */
+void update(const std::string& delta_path, const std::string& model_path) {
+    // read the classifier
+    const ModelFormat format = model_format(model_path);
+    ir::Vocabulary vocab;
+    ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> clf;
+    ir::ThreadPool pool;
+    load_model(model_path, clf, vocab, pool);
+
+    // update the classifier with the additional training set in batches
+    ir::DatasetReader reader(delta_path, vocab);
+    ir::dataset_batch batch;
+    while (reader.next_batch(BatchSize, batch)) {
+        clf.partial_fit(batch.x, batch.y);
+    }
+
+    // save the classifier in the format it is read
+    save_model(model_path, clf, vocab, format);
+}
+
+/**
+ * @brief Merge the models in the given paths and save the result to the given
+ * path.
+ *
+ * The merged model is the same as the model fitted on the union of the
+ * training sets of the input models. If every input model is in the binary
+ * format and a binary output is requested, the models are merged in a
+ * streaming fashion without loading them to memory; otherwise, every model is
+ * loaded and merged using ir::NaiveBayesClassifier::merge.
+ *
+ * @param input_paths Paths to already fitted model files in any format.
+ * @param model_path Path to which the merged model is going to be saved.
+ * @param format Format to save the model in.
+ *
+ * @return true if the merged model is saved; false, if it cannot be written
+ * to model_path.
+ */
+bool merge(const std::vector<std::string>& input_paths,
+           const std::string& model_path,
+           ModelFormat format = ModelFormat::Binary) {
+    const bool binary_inputs = std::all_of(
+        input_paths.begin(), input_paths.end(), ir::is_binary_model);
+    if (binary_inputs && format == ModelFormat::Binary) {
+        std::vector<ir::ModelFile<ir::DocClass>> models;
+        models.reserve(input_paths.size());
+        for (const auto& path : input_paths) {
+            models.emplace_back(path);
+        }
+
+        // write to a temporary file since model_path may be one of the inputs
+        const std::string tmp_path = model_path + ".tmp";
+        {
+            std::ofstream model_file(tmp_path, std::ios::binary);
+            ir::merge_binary_models(model_file, models);
+            if (!model_file.flush()) {
+                std::cerr << "Cannot write " << tmp_path << std::endl;
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+        if (std::rename(tmp_path.c_str(), model_path.c_str()) != 0) {
+            std::cerr << "Cannot rename " << tmp_path << " to " << model_path
+                      << ": " << std::strerror(errno) << std::endl;
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    ir::Vocabulary vocab;
+    ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> clf;
+    ir::ThreadPool pool;
+    for (const auto& path : input_paths) {
+        ir::NaiveBayesClassifier<ir::term_id, ir::DocClass> part;
+        load_model(path, part, vocab, pool);
+        clf.merge(part);
+    }
+
+    save_model(model_path, clf, vocab, format);
+    return true;
+}
+
 /**
  * @brief Main classifier program.
  *
@@ -331,30 +1082,29 @@ void predict(const std::string& test_path, const std::string& model_path) {
  * @param argc Number of arguments.
  * @param argv Arguments (array of C-strings).
  *
- * @return 0 if no errors occur; -1 if incorrect arguments are given.
+ * @return 0 if no errors occur; -1 if incorrect arguments are given or the
+ * merged model cannot be saved.
  */
 int main(int argc, char** argv) {
-    if (!correct_args(argc, argv)) {
+    ProgramArgs args;
+    if (!parse_args(argc, argv, args)) {
         print_usage(argv[0] + 2);
         return -1;
     }
 
-    std::string option(argv[1]);
-    if (option == FitArg) {
-        std::string train_path(argv[2]);
-        std::string model_path(argv[3]);
-
-        if (argc == 6) {
-            size_t num_features = std::stoul(argv[5]);
-            fit(train_path, model_path, num_features);
-        } else {
-            fit(train_path, model_path);
+    if (args.option == FitArg) {
+        fit(args.data_path, args.model_path, args.num_features,
+            args.num_threads, args.model_format);
+    } else if (args.option == PredictArg && args.data_path == StdinPath) {
+        predict_stream(args.model_path, args.top_k);
+    } else if (args.option == PredictArg) {
+        predict(args.data_path, args.model_path, args.num_threads, args.top_k);
+    } else if (args.option == UpdateArg) {
+        update(args.data_path, args.model_path);
+    } else if (args.option == MergeArg) {
+        if (!merge(args.input_paths, args.model_path, args.model_format)) {
+            return -1;
         }
-    } else if (option == PredictArg) {
-        std::string test_path(argv[2]);
-        std::string model_path(argv[3]);
-
-        predict(test_path, model_path);
     }
 
     return 0;
@@ -15,64 +15,130 @@
  */
 
 #include <algorithm>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <tokenizer.hpp>
+#include "bounded_queue.hpp"
+#include "dataset_cache.hpp"
+#include "dataset_file.hpp"
 #include "doc_preprocessor.hpp"
 #include "file_manager.hpp"
+#include "mapped_file.hpp"
 #include "parser.hpp"
+#include "thread_pool.hpp"
+#include "util.hpp"
+
+/**
+ * @brief Minimum number of bytes of a Reuters sgm file parsed as a single task.
+ */
+static const size_t ParseChunkSize = 1 << 20;
+
+/**
+ * @brief Number of documents tokenized as a single task.
+ */
+static const size_t TokenizeChunkSize = 64;
+
+/**
+ * @brief Maximum number of documents waiting between two stages of
+ * stream_datasets.
+ */
+static const size_t PipelineQueueSize = 256;
+
+/**
+ * @brief Remove unrelated classes of the given document and return whether
+ * the document should be put to the train or test dataset.
+ *
+ * @param doc Parsed document. Its topics are left with the target classes
+ * only.
+ *
+ * @return true if the document is a train or test document belonging to
+ * exactly one target class; false, otherwise.
+ */
+static bool keep_doc(ir::sgml_doc& doc) {
+    auto& classes = doc.topics;
+
+    // get rid of unrelated classes
+    classes.erase(
+        std::remove(classes.begin(), classes.end(), ir::DocClass::Other),
+        classes.end());
+
+    // if doc belongs to more than one target class, don't use it.
+    return classes.size() == 1 && (doc.type == ir::DocType::Train ||
+                                   doc.type == ir::DocType::Test);
+}
+
+/**
+ * @brief Store the raw content of the given document, i.e. its title and body
+ * separated by a newline, in raw.
+ *
+ * @param doc Parsed document.
+ * @param raw Reference to store the raw content of the document.
+ */
+static void assign_raw_doc(const ir::sgml_doc& doc, ir::raw_doc& raw) {
+    raw.reserve(doc.title.size() + 1 + doc.body.size());
+    raw.assign(doc.title);
+    raw += '\n';
+    raw.append(doc.body);
+}
 
 /**
  * @brief Return an index from document IDs to raw document content constructed
  * from all the documents in the given file_list.
  *
+ * Each file is split into chunks of whole documents using ir::split_sgml, and
+ * chunks of all the files are parsed concurrently on the given pool. Each chunk
+ * is parsed into its own list of documents; the lists are then merged in file
+ * order, so the result does not depend on the number of threads.
+ *
  * @param file_list vector of document paths containing the individual
- * documents to be extracted using ir::parse_file.
+ * documents to be extracted using ir::parse_sgml.
+ * @param pool Thread pool to parse the files on.
  *
  * @return Mapping from document ID to raw document content.
  */
 std::tuple<ir::raw_doc_index, ir::doc_class_index, ir::raw_doc_index,
            ir::doc_class_index>
-docs_from_files(const std::vector<std::string>& file_list) {
+docs_from_files(const std::vector<std::string>& file_list,
+                ir::ThreadPool& pool) {
     ir::raw_doc_index train_docs, test_docs;
     ir::doc_class_index train_classes, test_classes;
 
-    ir::raw_doc_index docs;
-    ir::doc_type_index doc_types;
-    ir::doc_multiclass_index doc_classes;
+    // map all the files and split them into chunks of whole documents
+    std::vector<ir::MappedFile> files;
+    std::vector<std::string_view> chunks;
+    files.reserve(file_list.size());
     for (const auto& filepath : file_list) {
-        std::ifstream ifs(filepath);
-        // get all the docs in the current file
-        std::tie(docs, doc_types, doc_classes) = ir::parse_file(ifs);
-        // put each document to its corresponding container (train/test)
-        for (const auto& pair : doc_types) {
-            const size_t id = pair.first;
-            const ir::DocType type = pair.second;
-            const auto& doc = docs[id];
-            auto classes = doc_classes[id];
-
-            // get rid of unrelated classes
-            classes.erase(std::remove(classes.begin(), classes.end(),
-                                      ir::DocClass::Other),
-                          classes.end());
-
-            // if doc belongs to more than one target class, don't use it.
-            if (classes.size() != 1) {
+        files.emplace_back(filepath);
+        const auto file_chunks = ir::split_sgml(
+            {files.back().data(), files.back().size()}, ParseChunkSize);
+        chunks.insert(chunks.end(), file_chunks.begin(), file_chunks.end());
+    }
+
+    // parse all the chunks in place; each chunk has its own output slot
+    std::vector<std::vector<ir::sgml_doc>> chunk_docs(chunks.size());
+    pool.parallel_for(chunks.size(), 1, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            chunk_docs[i] = ir::parse_sgml(chunks[i]);
+        }
+    });
+
+    for (auto& docs : chunk_docs) {
+        for (auto& doc : docs) {
+            if (!keep_doc(doc)) {
                 continue;
             }
             // put the document and its class to corresponding container
             // (train/test)
-            switch (type) {
-            case ir::DocType::Train:
-                train_docs[id] = doc;
-                train_classes[id] = classes[0];
-                break;
-            case ir::DocType::Test:
-                test_docs[id] = doc;
-                test_classes[id] = classes[0];
-                break;
-            default:
-                break;
+            if (doc.type == ir::DocType::Train) {
+                assign_raw_doc(doc, train_docs[doc.id]);
+                train_classes[doc.id] = doc.topics[0];
+            } else {
+                assign_raw_doc(doc, test_docs[doc.id]);
+                test_classes[doc.id] = doc.topics[0];
             }
         }
     }
@@ -81,41 +147,622 @@ docs_from_files(const std::vector<std::string>& file_list) {
 };
 
 /**
- * @brief Return an index from document IDs to vectors of normalized terms in
- * the corresponding documents.
+ * @brief Return an index from document IDs to normalized term ids and their
+ * counts in the corresponding documents.
  *
+ * Documents are tokenized and normalized concurrently in chunks of
+ * TokenizeChunkSize documents using the threads of the given pool. Their terms
+ * are then interned to the given vocabulary on the calling thread.
+ *
+ * @param tokenizer Tokenizer to tokenize and normalize the documents.
  * @param raw_docs Index from document IDs to raw document content.
+ * @param vocab Vocabulary to intern the normalized terms.
+ * @param pool Thread pool to tokenize the documents on.
  *
- * @return Mapping from document IDs to vectors of normalized terms.
+ * @return Mapping from document IDs to term ids and their counts.
  */
-ir::doc_term_index terms_from_raw_docs(ir::Tokenizer& tokenizer,
-                                       const ir::raw_doc_index& raw_docs) {
-    ir::doc_term_index term_docs;
+ir::id_term_index terms_from_raw_docs(ir::Tokenizer& tokenizer,
+                                      const ir::raw_doc_index& raw_docs,
+                                      ir::Vocabulary& vocab,
+                                      ir::ThreadPool& pool) {
+    std::vector<const ir::raw_doc_index::value_type*> docs;
+    docs.reserve(raw_docs.size());
     for (const auto& pair : raw_docs) {
-        const size_t id = pair.first;
-        const auto& raw_doc = pair.second;
-        // get all the normalized terms in the raw document content and store in
-        // document id
-        term_docs[id] = tokenizer.get_doc_terms(raw_doc);
+        docs.push_back(&pair);
+    }
+
+    // get all the normalized terms in each raw document content
+    std::vector<ir::doc_sample> doc_terms(docs.size());
+    pool.parallel_for(docs.size(), TokenizeChunkSize,
+                      [&](size_t beg, size_t end) {
+                          for (size_t i = beg; i < end; ++i) {
+                              doc_terms[i] =
+                                  tokenizer.get_doc_terms(docs[i]->second);
+                          }
+                      });
+
+    // store the terms in document id
+    ir::id_term_index term_docs;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        term_docs[docs[i]->first] = vocab.to_ids(doc_terms[i]);
+        doc_terms[i] = ir::doc_sample();
     }
     return term_docs;
 }
 
+/**
+ * @brief A document flowing through the stages of stream_datasets.
+ */
+struct pipeline_doc {
+    size_t id;
+    ir::DocType type;
+    ir::DocClass doc_class;
+    ir::raw_doc raw;
+    ir::doc_sample terms;
+};
+
+/**
+ * @brief Construct the train and test datasets from all the documents in the
+ * given file_list in a single pass and write them to the given output
+ * streams.
+ *
+ * Each document flows through a pipeline of parsing, HTML decoding,
+ * tokenization and serialization, and is released as soon as it is written.
+ * Parsing, decoding and tokenization run on their own threads and are
+ * connected by ir::BoundedQueue objects of PipelineQueueSize documents;
+ * serialization runs on the calling thread. Hence, peak memory does not depend
+ * on the size of the corpus. Documents are written in the order they appear
+ * in the files.
+ *
+ * @param file_list vector of document paths containing the individual
+ * documents to be extracted using ir::parse_sgml.
+ * @param tokenizer Tokenizer to tokenize and normalize the documents.
+ * @param train_os Output stream to write the train dataset to.
+ * @param test_os Output stream to write the test dataset to.
+ *
+ * @return Number of documents written to the train and test datasets.
+ */
+std::pair<size_t, size_t>
+stream_datasets(const std::vector<std::string>& file_list,
+                ir::Tokenizer& tokenizer, std::ostream& train_os,
+                std::ostream& test_os) {
+    ir::BoundedQueue<pipeline_doc> parsed(PipelineQueueSize);
+    ir::BoundedQueue<pipeline_doc> decoded(PipelineQueueSize);
+    ir::BoundedQueue<pipeline_doc> tokenized(PipelineQueueSize);
+
+    // run a stage on its own thread and close its output queue when it ends;
+    // if it fails, close every queue so that all the other stages stop, too
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto start_stage = [&](ir::BoundedQueue<pipeline_doc>& out, auto stage) {
+        return std::thread([&, stage, out_queue = &out]() {
+            try {
+                stage();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                parsed.close();
+                decoded.close();
+                tokenized.close();
+            }
+            out_queue->close();
+        });
+    };
+
+    std::thread parser = start_stage(parsed, [&]() {
+        for (const auto& filepath : file_list) {
+            const ir::MappedFile file(filepath);
+            const auto chunks =
+                ir::split_sgml({file.data(), file.size()}, ParseChunkSize);
+            for (const auto& chunk : chunks) {
+                for (auto& doc : ir::parse_sgml(chunk)) {
+                    if (!keep_doc(doc)) {
+                        continue;
+                    }
+                    pipeline_doc out{doc.id, doc.type, doc.topics[0], {}, {}};
+                    assign_raw_doc(doc, out.raw);
+                    if (!parsed.push(std::move(out))) {
+                        return;
+                    }
+                }
+            }
+        }
+    });
+    std::thread decoder = start_stage(decoded, [&]() {
+        pipeline_doc doc;
+        while (parsed.pop(doc)) {
+            ir::convert_html_special_chars(doc.raw);
+            if (!decoded.push(std::move(doc))) {
+                return;
+            }
+        }
+    });
+    std::thread normalizer = start_stage(tokenized, [&]() {
+        pipeline_doc doc;
+        while (decoded.pop(doc)) {
+            doc.terms = tokenizer.get_doc_terms(doc.raw);
+            // raw content is not needed anymore
+            doc.raw = ir::raw_doc();
+            if (!tokenized.push(std::move(doc))) {
+                return;
+            }
+        }
+    });
+
+    // serialize on the calling thread
+    size_t n_train = 0, n_test = 0;
+    pipeline_doc doc;
+    while (tokenized.pop(doc)) {
+        if (doc.type == ir::DocType::Train) {
+            ir::write_document(train_os, doc.id, doc.doc_class, doc.terms);
+            ++n_train;
+        } else {
+            ir::write_document(test_os, doc.id, doc.doc_class, doc.terms);
+            ++n_test;
+        }
+    }
+    train_os << std::flush;
+    test_os << std::flush;
+
+    parser.join();
+    decoder.join();
+    normalizer.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return {n_train, n_test};
+}
+
+/**
+ * @brief Rebuild the cache entry of the given Reuters sgm file.
+ *
+ * Documents are written to the shards of the entry in the order they appear
+ * in the file. Entries of different files can be rebuilt concurrently.
+ *
+ * @param filepath Path of a Reuters sgm file.
+ * @param tokenizer Tokenizer to tokenize and normalize the documents.
+ * @param cache Cache whose entry is rebuilt.
+ *
+ * @return Number of documents written to the train and test shards.
+ */
+std::pair<size_t, size_t> build_cache_entry(const std::string& filepath,
+                                            ir::Tokenizer& tokenizer,
+                                            ir::DatasetCache& cache) {
+    cache.invalidate(filepath);
+
+    const ir::MappedFile file(filepath);
+    const std::string_view text(file.data(), file.size());
+    std::ofstream train_ofs(cache.train_shard(filepath), std::ios_base::trunc);
+    std::ofstream test_ofs(cache.test_shard(filepath), std::ios_base::trunc);
+    size_t n_train = 0, n_test = 0;
+    ir::raw_doc raw;
+    for (auto& doc : ir::parse_sgml(text)) {
+        if (!keep_doc(doc)) {
+            continue;
+        }
+        assign_raw_doc(doc, raw);
+        ir::convert_html_special_chars(raw);
+        const auto terms = tokenizer.get_doc_terms(raw);
+        if (doc.type == ir::DocType::Train) {
+            ir::write_document(train_ofs, doc.id, doc.topics[0], terms);
+            ++n_train;
+        } else {
+            ir::write_document(test_ofs, doc.id, doc.topics[0], terms);
+            ++n_test;
+        }
+    }
+    train_ofs.close();
+    test_ofs.close();
+    if (!train_ofs || !test_ofs) {
+        throw std::runtime_error("cannot write the cache entry of " + filepath);
+    }
+
+    cache.store(filepath, text, n_train, n_test);
+    return {n_train, n_test};
+}
+
+/**
+ * @brief Concatenate the given text dataset shards to a single text dataset
+ * file.
+ *
+ * @param shards Paths of the shards in the order they are written.
+ * @param out_path Path of the text dataset file.
+ */
+void concatenate_shards(const std::vector<std::string>& shards,
+                        const std::string& out_path) {
+    std::ofstream ofs(out_path, std::ios_base::trunc);
+    for (const auto& shard : shards) {
+        std::ifstream ifs(shard);
+        // copying an empty stream buffer sets failbit of the output stream
+        if (ifs.peek() != std::ifstream::traits_type::eof()) {
+            ofs << ifs.rdbuf();
+        }
+    }
+}
+
+/**
+ * @brief Read the documents of the given text dataset shards into an index.
+ *
+ * @param shards Paths of the shards.
+ * @param vocab Vocabulary to intern the terms of the documents.
+ *
+ * @return Mapping from document IDs to term ids and their counts, and mapping
+ * from document IDs to their classes.
+ */
+std::pair<ir::id_term_index, ir::doc_class_index>
+read_shards(const std::vector<std::string>& shards, ir::Vocabulary& vocab) {
+    ir::id_term_index docs;
+    ir::doc_class_index classes;
+    ir::dataset_doc doc;
+    for (const auto& shard : shards) {
+        ir::DatasetReader reader(shard, vocab);
+        while (reader.next(doc)) {
+            classes[doc.id] = doc.doc_class;
+            docs[doc.id] = std::move(doc.terms);
+        }
+    }
+    return {std::move(docs), std::move(classes)};
+}
+
+/**
+ * @brief Write the given documents to the given path in the text, binary or
+ * compressed dataset format.
+ *
+ * @param path Path of the dataset file.
+ * @param binary Whether to use the binary dataset format.
+ * @param compressed Whether to use the compressed dataset format.
+ * @param docs Mapping from document IDs to term ids and their counts.
+ * @param classes Mapping from document IDs to their classes.
+ * @param vocab Vocabulary the term ids belong to.
+ */
+void write_dataset_file(const std::string& path, bool binary, bool compressed,
+                        const ir::id_term_index& docs,
+                        const ir::doc_class_index& classes,
+                        const ir::Vocabulary& vocab) {
+    if (binary) {
+        std::ofstream ofs(path, std::ios::binary);
+        ir::write_binary_dataset(ofs, docs, classes, vocab);
+    } else if (compressed) {
+        std::ofstream ofs(path, std::ios::binary);
+        ir::write_compressed_dataset(ofs, docs, classes, vocab);
+    } else {
+        std::ofstream ofs(path, std::ios_base::trunc);
+        ir::write_dataset(ofs, docs, classes, vocab);
+    }
+}
+
+/**
+ * @brief Partition the given documents into the given number of shards by
+ * ir::shard_of, write each shard as a separate dataset file and list the
+ * shards in a manifest.
+ *
+ * Shards are named by ir::shard_path and written concurrently using the
+ * threads of the given pool.
+ *
+ * @param dataset_path Path of the unsharded dataset.
+ * @param manifest_path Path of the manifest file.
+ * @param n_shards Number of shards. Must be positive.
+ * @param binary Whether to use the binary dataset format.
+ * @param compressed Whether to use the compressed dataset format.
+ * @param docs Mapping from document IDs to term ids and their counts. Its
+ * entries are moved into the shards.
+ * @param classes Mapping from document IDs to their classes.
+ * @param vocab Vocabulary the term ids belong to.
+ * @param pool Thread pool to write the shards on.
+ */
+void write_sharded_dataset(const std::string& dataset_path,
+                           const std::string& manifest_path, size_t n_shards,
+                           bool binary, bool compressed, ir::id_term_index docs,
+                           const ir::doc_class_index& classes,
+                           const ir::Vocabulary& vocab, ir::ThreadPool& pool) {
+    std::vector<ir::id_term_index> shards(n_shards);
+    for (auto& pair : docs) {
+        shards[ir::shard_of(pair.first, n_shards)].emplace(
+            pair.first, std::move(pair.second));
+    }
+    docs.clear();
+
+    // manifest and shards are in the same directory
+    ir::shard_manifest manifest;
+    for (size_t i = 0; i < n_shards; ++i) {
+        const std::string path = ir::shard_path(dataset_path, i);
+        manifest.paths.push_back(path.substr(path.rfind('/') + 1));
+        manifest.n_docs.push_back(shards[i].size());
+    }
+
+    pool.parallel_for(n_shards, 1, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            write_dataset_file(ir::shard_path(dataset_path, i), binary,
+                               compressed, shards[i], classes, vocab);
+        }
+    });
+
+    std::ofstream manifest_ofs(manifest_path, std::ios_base::trunc);
+    ir::write_manifest(manifest_ofs, manifest);
+}
+
+/**
+ * @brief Write the given train and test documents to the given paths in the
+ * text, binary or compressed dataset format.
+ *
+ * If n_shards is positive, each dataset is written as n_shards shards listed
+ * in ir::TRAIN_MANIFEST_PATH and ir::TEST_MANIFEST_PATH instead (see
+ * write_sharded_dataset).
+ *
+ * @param train_path Path of the train dataset file.
+ * @param test_path Path of the test dataset file.
+ * @param binary Whether to use the binary dataset format.
+ * @param compressed Whether to use the compressed dataset format.
+ * @param n_shards Number of shards of each dataset (0 means unsharded).
+ * @param train_docs Mapping from train document IDs to term ids and counts.
+ * @param train_classes Mapping from train document IDs to their classes.
+ * @param test_docs Mapping from test document IDs to term ids and counts.
+ * @param test_classes Mapping from test document IDs to their classes.
+ * @param vocab Vocabulary the term ids belong to.
+ * @param pool Thread pool to write the shards on.
+ */
+void write_datasets(const std::string& train_path, const std::string& test_path,
+                    bool binary, bool compressed, size_t n_shards,
+                    ir::id_term_index train_docs,
+                    const ir::doc_class_index& train_classes,
+                    ir::id_term_index test_docs,
+                    const ir::doc_class_index& test_classes,
+                    const ir::Vocabulary& vocab, ir::ThreadPool& pool) {
+    if (n_shards == 0) {
+        write_dataset_file(train_path, binary, compressed, train_docs,
+                           train_classes, vocab);
+        write_dataset_file(test_path, binary, compressed, test_docs,
+                           test_classes, vocab);
+        return;
+    }
+    write_sharded_dataset(train_path, ir::TRAIN_MANIFEST_PATH, n_shards, binary,
+                          compressed, std::move(train_docs), train_classes,
+                          vocab, pool);
+    write_sharded_dataset(test_path, ir::TEST_MANIFEST_PATH, n_shards, binary,
+                          compressed, std::move(test_docs), test_classes, vocab,
+                          pool);
+}
+
+/**
+ * @brief Write the words memoized by the given tokenizer to the given path and
+ * output the stem memo statistics.
+ *
+ * @param tokenizer Tokenizer that normalized the documents.
+ * @param path Path of the file to preload the stems from in the next run.
+ */
+void save_stem_cache(const ir::Tokenizer& tokenizer, const std::string& path) {
+    std::ofstream ofs(path, std::ios_base::trunc);
+    tokenizer.save_stems(ofs);
+
+    const auto stats = tokenizer.stem_stats();
+    const size_t lookups = stats.hits + stats.misses;
+    std::cerr << stats.hits << " of " << lookups
+              << " stems was found in the stem cache saved at " << path
+              << std::endl;
+}
+
+/**
+ * @brief Binary dataset format argument string.
+ */
+static const std::string BinaryArg = "--binary";
+/**
+ * @brief Compressed dataset format argument string.
+ */
+static const std::string CompressedArg = "--compressed";
+/**
+ * @brief Number of threads argument string.
+ */
+static const std::string ThreadsArg = "--threads";
+/**
+ * @brief Single-pass streaming construction argument string.
+ */
+static const std::string StreamArg = "--stream";
+/**
+ * @brief Incremental construction using the per-file cache argument string.
+ */
+static const std::string CacheArg = "--cache";
+/**
+ * @brief Number of shards argument string.
+ */
+static const std::string ShardsArg = "--shards";
+/**
+ * @brief Stem cache file argument string.
+ */
+static const std::string StemCacheArg = "--stem-cache";
+
 /**
  * @brief Main routine to parse Reuters sgm files, build the positional inverted
  * index and write the dictionary to ir::DICT_PATH and the index to
  * ir::INDEX_PATH.
  *
- * @return 0 if successful.
+ * If --binary argument is given, datasets are written in the binary dataset
+ * format to ir::TRAIN_BINARY_SET_PATH and ir::TEST_BINARY_SET_PATH instead.
+ * If --compressed argument is given, datasets are written in the compressed
+ * dataset format to ir::TRAIN_COMPRESSED_SET_PATH and
+ * ir::TEST_COMPRESSED_SET_PATH instead.
+ * If --threads N argument is given, sgm files are parsed and documents are
+ * tokenized using N threads; if N is 0, all hardware threads are used. If
+ * --stream argument is given, text
+ * datasets are constructed in a single pass using stream_datasets which keeps
+ * only a bounded number of documents in memory. If --cache argument is given,
+ * documents of each sgm file are cached in ir::DATASET_CACHE_DIR and only the
+ * files that changed since the last run are parsed again; datasets are then
+ * assembled from the cached documents in file order. If --shards N argument is
+ * given, each dataset is partitioned into N shards by the hash of document ids
+ * and the shards are listed in ir::TRAIN_MANIFEST_PATH and
+ * ir::TEST_MANIFEST_PATH. If --stem-cache PATH argument is given, the words
+ * in PATH are stemmed once before tokenization, and the words stemmed during
+ * tokenization are written back to PATH for the next run.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments (array of C-strings).
+ *
+ * @return 0 if successful; -1 if incorrect arguments are given.
  */
-int main() {
-    std::cerr << "Constructing train and test datasets..." << std::flush;
+int main(int argc, char** argv) {
+    bool binary = false;
+    bool compressed = false;
+    bool stream = false;
+    bool cached = false;
+    size_t num_threads = 1;
+    size_t n_shards = 0;
+    std::string stem_cache_path;
+    bool valid_args = true;
+    for (int i = 1; i < argc && valid_args; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == BinaryArg) {
+            binary = true;
+        } else if (arg == CompressedArg) {
+            compressed = true;
+        } else if (arg == StreamArg) {
+            stream = true;
+        } else if (arg == CacheArg) {
+            cached = true;
+        } else if (arg == ThreadsArg && i + 1 < argc) {
+            const std::string value(argv[++i]);
+            valid_args = ir::parse_size(value, num_threads);
+        } else if (arg == ShardsArg && i + 1 < argc) {
+            const std::string value(argv[++i]);
+            valid_args = ir::parse_size(value, n_shards) && n_shards > 0;
+        } else if (arg == StemCacheArg && i + 1 < argc) {
+            stem_cache_path = argv[++i];
+        } else {
+            valid_args = false;
+        }
+    }
+    // binary and compressed datasets can only be written after all the
+    // documents are read; the cache is built one file at a time
+    if (!valid_args || binary + compressed + stream > 1 ||
+        stream + cached > 1 || (stream && n_shards > 0)) {
+        std::cerr << "usage: " << argv[0] << " [" << BinaryArg << " | "
+                  << CompressedArg << " | " << StreamArg << ']' << " ["
+                  << CacheArg << "] [" << ShardsArg << " N] [" << ThreadsArg
+                  << " N] [" << StemCacheArg << " PATH]" << std::endl;
+        return -1;
+    }
+    std::string train_path = ir::TRAIN_SET_PATH;
+    std::string test_path = ir::TEST_SET_PATH;
+    if (binary) {
+        train_path = ir::TRAIN_BINARY_SET_PATH;
+        test_path = ir::TEST_BINARY_SET_PATH;
+    } else if (compressed) {
+        train_path = ir::TRAIN_COMPRESSED_SET_PATH;
+        test_path = ir::TEST_COMPRESSED_SET_PATH;
+    }
+    // a sharded dataset is referred to by its manifest
+    const std::string train_out = n_shards > 0 ? ir::TRAIN_MANIFEST_PATH
+                                               : train_path;
+    const std::string test_out = n_shards > 0 ? ir::TEST_MANIFEST_PATH
+                                              : test_path;
+
     ir::Tokenizer tokenizer;
+    if (!stem_cache_path.empty()) {
+        // the stem cache does not exist in the first run
+        std::ifstream stem_ifs(stem_cache_path);
+        tokenizer.preload_stems(stem_ifs);
+    }
+
+    if (stream) {
+        std::cerr << "Constructing and writing train and test datasets..."
+                  << std::flush;
+        std::ofstream train_ofs(train_path, std::ios_base::trunc);
+        std::ofstream test_ofs(test_path, std::ios_base::trunc);
+        size_t n_train, n_test;
+        std::tie(n_train, n_test) = stream_datasets(
+            ir::get_data_file_list(), tokenizer, train_ofs, test_ofs);
+        std::cerr << "OK!" << std::endl;
+
+        // output statistics
+        std::cerr << n_train
+                  << " documents was indexed to construct the train dataset at "
+                  << train_path << std::endl;
+        std::cerr << n_test
+                  << " documents was indexed to construct the test  dataset at "
+                  << test_path << std::endl;
+
+        if (!stem_cache_path.empty()) {
+            save_stem_cache(tokenizer, stem_cache_path);
+        }
+
+        return 0;
+    }
+
+    if (cached) {
+        std::cerr << "Updating dataset cache..." << std::flush;
+        ir::ThreadPool pool(num_threads);
+        ir::DatasetCache cache(ir::DATASET_CACHE_DIR);
+        const auto file_list = ir::get_data_file_list();
+        std::vector<std::pair<size_t, size_t>> file_counts(file_list.size());
+        std::vector<size_t> stale;
+        for (size_t i = 0; i < file_list.size(); ++i) {
+            auto& counts = file_counts[i];
+            if (!cache.lookup(file_list[i], counts.first, counts.second)) {
+                stale.push_back(i);
+            }
+        }
+
+        // entries are independent of each other; rebuild one file per task
+        pool.parallel_for(stale.size(), 1, [&](size_t beg, size_t end) {
+            for (size_t i = beg; i < end; ++i) {
+                file_counts[stale[i]] =
+                    build_cache_entry(file_list[stale[i]], tokenizer, cache);
+            }
+        });
+
+        std::vector<std::string> train_shards, test_shards;
+        size_t n_train = 0, n_test = 0;
+        for (size_t i = 0; i < file_list.size(); ++i) {
+            train_shards.push_back(cache.train_shard(file_list[i]));
+            test_shards.push_back(cache.test_shard(file_list[i]));
+            n_train += file_counts[i].first;
+            n_test += file_counts[i].second;
+        }
+        std::cerr << "OK! (" << stale.size() << " of " << file_list.size()
+                  << " files rebuilt)" << std::endl;
+        std::cerr << "Writing train and test dataset files..." << std::flush;
+
+        if (binary || compressed || n_shards > 0) {
+            ir::Vocabulary vocab;
+            ir::id_term_index train_docs, test_docs;
+            ir::doc_class_index train_classes, test_classes;
+            std::tie(train_docs, train_classes) =
+                read_shards(train_shards, vocab);
+            std::tie(test_docs, test_classes) = read_shards(test_shards, vocab);
+            write_datasets(train_path, test_path, binary, compressed, n_shards,
+                           std::move(train_docs), train_classes,
+                           std::move(test_docs), test_classes, vocab, pool);
+        } else {
+            concatenate_shards(train_shards, train_path);
+            concatenate_shards(test_shards, test_path);
+        }
+
+        std::cerr << "OK!" << std::endl;
+
+        // output statistics
+        std::cerr << n_train
+                  << " documents was indexed to construct the train dataset at "
+                  << train_out << std::endl;
+        std::cerr << n_test
+                  << " documents was indexed to construct the test  dataset at "
+                  << test_out << std::endl;
+
+        if (!stem_cache_path.empty()) {
+            save_stem_cache(tokenizer, stem_cache_path);
+        }
+
+        return 0;
+    }
+
+    std::cerr << "Constructing train and test datasets..." << std::flush;
+    ir::ThreadPool pool(num_threads);
     // parse the files and read the docs
     ir::raw_doc_index train_docs, test_docs;
     ir::doc_class_index train_classes, test_classes;
     std::tie(train_docs, train_classes, test_docs, test_classes) =
-        docs_from_files(ir::get_data_file_list());
+        docs_from_files(ir::get_data_file_list(), pool);
 
     // handle special html character sequences
     for (auto& pair : train_docs) {
@@ -128,30 +775,34 @@ int main() {
     }
 
     // tokenize and normalize the documents
-    auto train_doc_terms_counts = terms_from_raw_docs(tokenizer, train_docs);
-    auto test_doc_terms_counts = terms_from_raw_docs(tokenizer, test_docs);
+    ir::Vocabulary vocab;
+    auto train_doc_terms_counts =
+        terms_from_raw_docs(tokenizer, train_docs, vocab, pool);
+    auto test_doc_terms_counts =
+        terms_from_raw_docs(tokenizer, test_docs, vocab, pool);
 
     std::cerr << "OK!" << std::endl;
     std::cerr << "Writing train and test dataset files..." << std::flush;
 
-    {
-        std::ofstream ofs(ir::TRAIN_SET_PATH, std::ios_base::trunc);
-        ir::write_dataset(ofs, train_doc_terms_counts, train_classes);
-    }
-    {
-        std::ofstream ofs(ir::TEST_SET_PATH, std::ios_base::trunc);
-        ir::write_dataset(ofs, test_doc_terms_counts, test_classes);
-    }
+    const size_t n_train = train_doc_terms_counts.size();
+    const size_t n_test = test_doc_terms_counts.size();
+    write_datasets(train_path, test_path, binary, compressed, n_shards,
+                   std::move(train_doc_terms_counts), train_classes,
+                   std::move(test_doc_terms_counts), test_classes, vocab, pool);
 
     std::cerr << "OK!" << std::endl;
 
     // output statistics
-    std::cerr << train_doc_terms_counts.size()
+    std::cerr << n_train
               << " documents was indexed to construct the train dataset at "
-              << ir::TRAIN_SET_PATH << std::endl;
-    std::cerr << test_doc_terms_counts.size()
+              << train_out << std::endl;
+    std::cerr << n_test
               << " documents was indexed to construct the test  dataset at "
-              << ir::TEST_SET_PATH << std::endl;
+              << test_out << std::endl;
+
+    if (!stem_cache_path.empty()) {
+        save_stem_cache(tokenizer, stem_cache_path);
+    }
 
     return 0;
 }
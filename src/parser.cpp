@@ -15,58 +15,54 @@
  */
 
 #include "parser.hpp"
+#include "util.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 /**
- * @brief Get the ID of a document with the given header line.
+ * @brief Return the value of the given field in the given header line.
  *
- * Header line of a document starts with ir::DOC_HEADER. ID of a document in the
- * header line is specified with ir::ID_FIELD. This function finds the ID field
- * in the header line and returns it as an integer.
+ * Header line of a document starts with ir::DOC_HEADER and contains fields of
+ * the form FIELD="VALUE" where field is given together with its opening quote.
  *
  * @param header_line Header line of a Reuters document starting with
  * ir::DOC_HEADER.
+ * @param field Field name followed by an equal sign and a quote.
  *
- * @return ID of the document.
+ * @return View of the value of the field; empty if the field does not exist.
  */
-int get_doc_id(const std::string& header_line) {
+static std::string_view get_header_field(std::string_view header_line,
+                                         std::string_view field) {
     // header start index
-    size_t newid_pos = header_line.find(ir::ID_FIELD);
-    // number beginning index
-    size_t num_beg_pos = newid_pos + ir::ID_FIELD.size();
-    // number end index
-    size_t num_end_pos = header_line.find('\"', num_beg_pos);
-
-    std::string num_str =
-        header_line.substr(num_beg_pos, num_end_pos - num_beg_pos);
+    const size_t field_pos = header_line.find(field);
+    if (field_pos == std::string_view::npos) {
+        return {};
+    }
+    // value beginning index
+    const size_t value_beg_pos = field_pos + field.size();
+    // value end index
+    const size_t value_end_pos = header_line.find('\"', value_beg_pos);
 
-    return std::atoi(num_str.c_str());
+    return header_line.substr(value_beg_pos, value_end_pos - value_beg_pos);
 }
 
 /**
  * @brief Get the type of a document (train/test) with the given header line.
  *
- * Header line of a document starts with ir::DOC_HEADER. Type of a document in
- * the header line is specified with ir::TRAIN_TEST_FIELD. This function finds
- * the type field in the header line and returns the corresponding ir::DocType
- * value.
+ * Type of a document in the header line is specified with
+ * ir::TRAIN_TEST_FIELD.
  *
  * @param header_line Header line of a Reuters document starting with
  * ir::DOC_HEADER.
  * @return Type of the document (train/test).
  */
-ir::DocType get_doc_type(const std::string& header_line) {
-    // header start index
-    size_t split_pos = header_line.find(ir::TRAIN_TEST_FIELD);
-    // number beginning index
-    size_t type_beg_pos = split_pos + ir::TRAIN_TEST_FIELD.size();
-    // number end index
-    size_t type_end_pos = header_line.find('\"', type_beg_pos);
-
-    std::string type =
-        header_line.substr(type_beg_pos, type_end_pos - type_beg_pos);
+static ir::DocType get_doc_type(std::string_view header_line) {
+    const std::string_view type =
+        get_header_field(header_line, ir::TRAIN_TEST_FIELD);
 
     if (type == ir::TRAIN_KEY) {
         return ir::DocType::Train;
@@ -77,184 +73,236 @@ ir::DocType get_doc_type(const std::string& header_line) {
 }
 
 /**
- * @brief Find the next document in the input stream and return its raw content.
+ * @brief Convert a class keyword in a topic list to ir::DocClass.
+ *
+ * @param doc_class Class keyword between ir::CLASS_BEG_TAG and
+ * ir::CLASS_END_TAG.
+ *
+ * @return Corresponding ir::DocClass; ir::DocClass::Other if it is not one of
+ * the target classes.
+ */
+static ir::DocClass get_doc_class(std::string_view doc_class) {
+    if (doc_class == ir::EARN_CLASS_KEY) {
+        return ir::DocClass::Earn;
+    } else if (doc_class == ir::ACQ_CLASS_KEY) {
+        return ir::DocClass::Acq;
+    } else if (doc_class == ir::MONEY_FX_CLASS_KEY) {
+        return ir::DocClass::MoneyFx;
+    } else if (doc_class == ir::GRAIN_CLASS_KEY) {
+        return ir::DocClass::Grain;
+    } else if (doc_class == ir::CRUDE_CLASS_KEY) {
+        return ir::DocClass::Crude;
+    }
+    return ir::DocClass::Other;
+}
+
+/**
+ * @brief Parse the next document topic list by advancing the given position
+ * until a topic list is found and extracting the topics, and return the
+ * result.
  *
- * Raw content of a document is defined as the text inside its ir::TXT_BEG_TAG
- * and ir::TXT_END_TAG s.
+ * A topic list is a line of the following structure:
  *
- * This function finds the next ir::TXT_BEG_TAG in the input stream and gets all
- * the text until ir::TXT_END_TAG is encountered.
+ * <blockquote>
+ *     <TOPICS><D>class1</D><D>class2</D>...</TOPICS>
+ * </blockquote>
  *
- * @param is Input stream from which next raw document will be extracted.
+ * @param pos Position to start searching from. It is advanced past the line of
+ * the topic list.
+ * @param end End of the text.
  *
- * @return Raw content of the next document in the input stream.
+ * @return std::vector of topics the document belongs to. If there are no
+ * topics, the returned vector is empty.
  *
- * @throws std::invalid_argument if input stream doesn't contain ir::TXT_BEG_TAG
- * and ir::TXT_END_TAG fields.
+ * @throws std::invalid_argument if there are no more topic lists.
  */
-ir::raw_doc get_next_doc(std::istream& is) {
-    std::string line;
-    size_t beg_header_pos;
-    size_t end_header_pos;
-    while (std::getline(is, line)) {
-        beg_header_pos = line.find(ir::TXT_BEG_TAG);
-        // if current line contains TXT_BEG_TAG
-        if (beg_header_pos != std::string::npos) {
-            std::string text;
+static std::vector<ir::DocClass> get_doc_topics(const char*& pos,
+                                                const char* end) {
+    std::vector<ir::DocClass> result;
 
-            // read all the text until TXT_END_TAG is encountered
-            do {
-                std::getline(is, line);
-                end_header_pos = line.find(ir::TXT_END_TAG);
-                text += "\n" + line.substr(0, end_header_pos);
-            } while (end_header_pos == std::string::npos);
+    while (pos != end) {
+        // advance until topic header beginning is found
+        const std::string_view line = ir::next_line(pos, end);
+        if (line.find(ir::TOPIC_HEADER_BEG) == std::string_view::npos) {
+            continue;
+        }
+
+        // iterate over all class tags
+        size_t class_tag_beg_pos = line.find(ir::CLASS_BEG_TAG);
+        while (class_tag_beg_pos != std::string_view::npos) {
+            const size_t class_tag_end_pos =
+                line.find(ir::CLASS_END_TAG, class_tag_beg_pos);
+
+            // current class tag indices
+            const size_t class_beg =
+                class_tag_beg_pos + ir::CLASS_BEG_TAG.size();
+            const size_t class_len = class_tag_end_pos - class_beg;
 
-            return text;
+            const std::string_view doc_class = line.substr(class_beg, class_len);
+            assert(!doc_class.empty());
+            result.push_back(get_doc_class(doc_class));
+
+            // go to the next class tag
+            class_tag_beg_pos = line.find(ir::CLASS_BEG_TAG, class_tag_end_pos);
         }
+
+        return result;
     }
     // we should never come here if the input is proper
-    throw std::invalid_argument("Input stream does not contain " +
-                                ir::TXT_BEG_TAG + " and " + ir::TXT_END_TAG +
-                                " fields");
+    throw std::invalid_argument("Input does not contain " +
+                                ir::TOPIC_HEADER_BEG + " and " +
+                                ir::TOPIC_HEADER_END + " tags");
 }
 
 /**
- * @brief Return the text between given tags.
+ * @brief Find the next document text by advancing the given position and
+ * return it.
  *
- * This function finds and returns the text between given two tags in the
- * given document. This is done by finding the positions of beg_tag and end_tag
- * and returning the substring between indices adjusted to exclude tags
- * themselves.
+ * Text of a document starts at the line following the line containing
+ * ir::TXT_BEG_TAG and ends at the following ir::TXT_END_TAG.
  *
- * If beg_tag is not in doc_text, then empty string is returned.
- * If end_tag is not in doc_text, then an assertion error is given.
+ * @param pos Position to start searching from. It is advanced past the line
+ * containing ir::TXT_END_TAG.
+ * @param end End of the text.
  *
- * @param doc_text Text containing beg_tag and end_tag
- * @param beg_tag Beginning tag.
- * @param end_tag End tag.
+ * @return View of the text of the next document.
  *
- * @return The text between beg_tag and end_tag.
+ * @throws std::invalid_argument if there is no ir::TXT_BEG_TAG followed by
+ * ir::TXT_END_TAG.
  */
-std::string text_between_tags(const std::string& doc_text,
-                              const std::string& beg_tag,
-                              const std::string& end_tag) {
-    size_t tag_beg_pos = doc_text.find(beg_tag);
-    // if no beg_tag, return empty string
-    if (tag_beg_pos == std::string::npos) {
-        return "";
-    }
+static std::string_view get_next_doc(const char*& pos, const char* end) {
+    while (pos != end) {
+        const std::string_view line = ir::next_line(pos, end);
+        // if current line contains TXT_BEG_TAG
+        if (line.find(ir::TXT_BEG_TAG) == std::string_view::npos) {
+            continue;
+        }
 
-    size_t tag_end_pos = doc_text.find(end_tag);
-    assert(tag_end_pos != std::string::npos);
+        // text continues until TXT_END_TAG is encountered
+        const std::string_view rest(pos, static_cast<size_t>(end - pos));
+        const size_t text_len = rest.find(ir::TXT_END_TAG);
+        if (text_len == std::string_view::npos) {
+            break;
+        }
 
-    // don't include the tag itself
-    size_t beg_index = tag_beg_pos + beg_tag.size();
-    size_t len = tag_end_pos - beg_index;
+        // continue from the line after TXT_END_TAG
+        pos += text_len;
+        ir::next_line(pos, end);
 
-    return doc_text.substr(beg_index, len);
+        return rest.substr(0, text_len);
+    }
+    // we should never come here if the input is proper
+    throw std::invalid_argument("Input does not contain " + ir::TXT_BEG_TAG +
+                                " and " + ir::TXT_END_TAG + " fields");
 }
 
 /**
- * @brief Parse the next document topic list by advancing the stream until a
- * topic list is found and extracting the topics, and return the result.
- *
- * A topic list is a line of the following structure:
+ * @brief Return the text between given tags.
  *
- * <blockquote>
- *     <TOPICS><D>class1</D><D>class2</D>...</TOPICS>
- * </blockquote>
+ * If beg_tag is not in doc_text, then an empty view is returned.
+ * If end_tag is not in doc_text, then an assertion error is given.
  *
- * @param is Input stream from which the next topic list will be extracted.
+ * @param doc_text Text containing beg_tag and end_tag
+ * @param beg_tag Beginning tag.
+ * @param end_tag End tag.
  *
- * @return std::vector of topics the document belongs to. If there are no
- * topics, the returned vector is empty.
+ * @return View of the text between beg_tag and end_tag.
  */
-std::vector<ir::DocClass> get_doc_topics(std::istream& is) {
-    std::vector<ir::DocClass> result;
+static std::string_view text_between_tags(std::string_view doc_text,
+                                          std::string_view beg_tag,
+                                          std::string_view end_tag) {
+    const size_t tag_beg_pos = doc_text.find(beg_tag);
+    // if no beg_tag, return empty text
+    if (tag_beg_pos == std::string_view::npos) {
+        return {};
+    }
 
-    std::string line;
-    size_t beg_header_pos;
-    while (std::getline(is, line)) {
-        // advance until topic header beginning is found
-        beg_header_pos = line.find(ir::TOPIC_HEADER_BEG);
-        if (beg_header_pos != std::string::npos) {
-            // find class beginning index
-            size_t class_tag_beg_pos = line.find(ir::CLASS_BEG_TAG);
-
-            // iterate over all class tags
-            while (class_tag_beg_pos != std::string::npos) {
-                size_t class_tag_end_pos =
-                    line.find(ir::CLASS_END_TAG, class_tag_beg_pos);
-
-                // current class tag indices
-                size_t class_beg = class_tag_beg_pos + ir::CLASS_BEG_TAG.size();
-                size_t class_len = class_tag_end_pos - class_beg;
-
-                // get document class
-                std::string doc_class = line.substr(class_beg, class_len);
-                assert(!doc_class.empty());
-
-                // switch the class
-                if (doc_class == ir::EARN_CLASS_KEY) {
-                    result.push_back(ir::DocClass::Earn);
-                } else if (doc_class == ir::ACQ_CLASS_KEY) {
-                    result.push_back(ir::DocClass::Acq);
-                } else if (doc_class == ir::MONEY_FX_CLASS_KEY) {
-                    result.push_back(ir::DocClass::MoneyFx);
-                } else if (doc_class == ir::GRAIN_CLASS_KEY) {
-                    result.push_back(ir::DocClass::Grain);
-                } else if (doc_class == ir::CRUDE_CLASS_KEY) {
-                    result.push_back(ir::DocClass::Crude);
-                } else {
-                    result.push_back(ir::DocClass::Other);
-                }
-
-                // go to the next class tag
-                class_tag_beg_pos =
-                    line.find(ir::CLASS_BEG_TAG, class_tag_end_pos);
-            }
+    // don't include the tag itself
+    const size_t beg_index = tag_beg_pos + beg_tag.size();
+    const size_t tag_end_pos = doc_text.find(end_tag, beg_index);
+    assert(tag_end_pos != std::string_view::npos);
+
+    return doc_text.substr(beg_index, tag_end_pos - beg_index);
+}
+
+std::vector<ir::sgml_doc> ir::parse_sgml(std::string_view text) {
+    std::vector<sgml_doc> docs;
 
-            return result;
+    const char* pos = text.data();
+    const char* end = text.data() + text.size();
+    while (pos != end) {
+        const std::string_view line = next_line(pos, end);
+        if (line.compare(0, DOC_HEADER.size(), DOC_HEADER) != 0) {
+            continue;
         }
+
+        // found a new document
+        sgml_doc doc;
+        if (!parse_size(get_header_field(line, ID_FIELD), doc.id)) {
+            throw std::invalid_argument("Document header does not contain " +
+                                        ID_FIELD + " field");
+        }
+        doc.type = get_doc_type(line);
+
+        // get document topics
+        doc.topics = get_doc_topics(pos, end);
+
+        // get document title and body
+        const std::string_view doc_text = get_next_doc(pos, end);
+        doc.title = text_between_tags(doc_text, TITLE_BEG_TAG, TITLE_END_TAG);
+        doc.body = text_between_tags(doc_text, BODY_BEG_TAG, BODY_END_TAG);
+
+        docs.push_back(std::move(doc));
     }
-    // we should never come here if the input is proper
-    throw std::invalid_argument("Input stream does not contain " +
-                                ir::TOPIC_HEADER_BEG + " and " +
-                                ir::TOPIC_HEADER_END + " tags");
+
+    return docs;
 }
 
-std::tuple<ir::raw_doc_index, ir::doc_type_index, ir::doc_multiclass_index >
+std::vector<std::string_view> ir::split_sgml(std::string_view text,
+                                             size_t chunk_size) {
+    std::vector<std::string_view> chunks;
+    chunk_size = std::max<size_t>(chunk_size, 1);
+
+    // a document header that starts a line
+    const std::string line_header = '\n' + DOC_HEADER;
+    size_t beg = 0;
+    while (beg < text.size()) {
+        size_t end = text.size();
+        if (chunk_size < text.size() - beg) {
+            // cut right before the next document header after chunk_size bytes
+            const size_t header_pos =
+                text.find(line_header, beg + chunk_size - 1);
+            if (header_pos != std::string_view::npos) {
+                end = header_pos + 1;
+            }
+        }
+        chunks.push_back(text.substr(beg, end - beg));
+        beg = end;
+    }
+
+    return chunks;
+}
+
+std::tuple<ir::raw_doc_index, ir::doc_type_index, ir::doc_multiclass_index>
 ir::parse_file(std::istream& ifs) {
     raw_doc_index docs;
     doc_type_index doc_types;
     doc_multiclass_index doc_classes;
-    std::string line;
-
-    int id;
-    DocType type;
-    raw_doc doc;
-    while (std::getline(ifs, line)) {
-        if (line.find(DOC_HEADER) == 0) {
-            // found a new document
-            id = get_doc_id(line);
-            type = get_doc_type(line);
-
-            // get document topics
-            auto topics = get_doc_topics(ifs);
-
-            // get document string
-            doc = get_next_doc(ifs);
-            doc = text_between_tags(doc, TITLE_BEG_TAG, TITLE_END_TAG) + "\n" +
-                  text_between_tags(doc, BODY_BEG_TAG, BODY_END_TAG);
-
-            // document string
-            docs[id] = doc;
-            // document type (train/test)
-            doc_types[id] = type;
-            // document topics
-            doc_classes[id] = topics;
-        }
+
+    const std::string text((std::istreambuf_iterator<char>(ifs)),
+                           std::istreambuf_iterator<char>());
+    for (auto& doc : parse_sgml(text)) {
+        // document string
+        raw_doc& raw = docs[doc.id];
+        raw.reserve(doc.title.size() + 1 + doc.body.size());
+        raw.assign(doc.title);
+        raw += '\n';
+        raw.append(doc.body);
+        // document type (train/test)
+        doc_types[doc.id] = doc.type;
+        // document topics
+        doc_classes[doc.id] = std::move(doc.topics);
     }
 
     return std::make_tuple(docs, doc_types, doc_classes);
-};
+}
@@ -35,8 +35,13 @@
        that if step1ab leaves a one letter result (ied -> i, aing -> a etc),
        step2 and step4 access the byte before the first letter. So we skip
        steps after step1ab unless k > k0.
+   Release 4: reentrant version
+       the state of the stemmer is kept in a struct stemmer passed to every
+       function instead of file-level statics, so that words can be stemmed
+       concurrently from multiple threads. The stemmed output is unchanged.
 */
 
+#include "porter_stemmer.hpp"
 #include <string.h>  /* for memmove */
 
 #define TRUE 1
@@ -52,15 +57,20 @@
    should be done before stem(...) is called.
 */
 
-static char * b;       /* buffer for word to be stemmed */
-static int k,k0,j;     /* j is a general offset into the string */
+/* The state of the stemmer while stemming a single word. Every function below
+   takes the context z and refers to its fields as z->b, z->k etc. */
+
+struct stemmer {
+    char * b;       /* buffer for word to be stemmed */
+    int k,k0,j;     /* j is a general offset into the string */
+};
 
 /* cons(i) is TRUE <=> b[i] is a consonant. */
 
-static int cons(int i)
-{  switch (b[i])
+static int cons(struct stemmer * z, int i)
+{  switch (z->b[i])
     {  case 'a': case 'e': case 'i': case 'o': case 'u': return FALSE;
-        case 'y': return (i==k0) ? TRUE : !cons(i-1);
+        case 'y': return (i==z->k0) ? TRUE : !cons(z, i-1);
         default: return TRUE;
     }
 }
@@ -76,25 +86,25 @@ static int cons(int i)
       ....
 */
 
-static int m()
+static int m(struct stemmer * z)
 {  int n = 0;
-    int i = k0;
+    int i = z->k0;
     while(TRUE)
-    {  if (i > j) return n;
-        if (! cons(i)) break; i++;
+    {  if (i > z->j) return n;
+        if (! cons(z, i)) break; i++;
     }
     i++;
     while(TRUE)
     {  while(TRUE)
-        {  if (i > j) return n;
-            if (cons(i)) break;
+        {  if (i > z->j) return n;
+            if (cons(z, i)) break;
             i++;
         }
         i++;
         n++;
         while(TRUE)
-        {  if (i > j) return n;
-            if (! cons(i)) break;
+        {  if (i > z->j) return n;
+            if (! cons(z, i)) break;
             i++;
         }
         i++;
@@ -103,17 +113,17 @@ static int m()
 
 /* vowelinstem() is TRUE <=> k0,...j contains a vowel */
 
-static int vowelinstem()
-{  int i; for (i = k0; i <= j; i++) if (! cons(i)) return TRUE;
+static int vowelinstem(struct stemmer * z)
+{  int i; for (i = z->k0; i <= z->j; i++) if (! cons(z, i)) return TRUE;
     return FALSE;
 }
 
 /* doublec(j) is TRUE <=> j,(j-1) contain a double consonant. */
 
-static int doublec(int j)
-{  if (j < k0+1) return FALSE;
-    if (b[j] != b[j-1]) return FALSE;
-    return cons(j);
+static int doublec(struct stemmer * z, int j)
+{  if (j < z->k0+1) return FALSE;
+    if (z->b[j] != z->b[j-1]) return FALSE;
+    return cons(z, j);
 }
 
 /* cvc(i) is TRUE <=> i-2,i-1,i has the form consonant - vowel - consonant
@@ -125,9 +135,9 @@ static int doublec(int j)
 
 */
 
-static int cvc(int i)
-{  if (i < k0+2 || !cons(i) || cons(i-1) || !cons(i-2)) return FALSE;
-    {  int ch = b[i];
+static int cvc(struct stemmer * z, int i)
+{  if (i < z->k0+2 || !cons(z, i) || cons(z, i-1) || !cons(z, i-2)) return FALSE;
+    {  int ch = z->b[i];
         if (ch == 'w' || ch == 'x' || ch == 'y') return FALSE;
     }
     return TRUE;
@@ -135,27 +145,27 @@ static int cvc(int i)
 
 /* ends(s) is TRUE <=> k0,...k ends with the string s. */
 
-static int ends(char * s)
+static int ends(struct stemmer * z, char * s)
 {  int length = s[0];
-    if (s[length] != b[k]) return FALSE; /* tiny speed-up */
-    if (length > k-k0+1) return FALSE;
-    if (memcmp(b+k-length+1,s+1,length) != 0) return FALSE;
-    j = k-length;
+    if (s[length] != z->b[z->k]) return FALSE; /* tiny speed-up */
+    if (length > z->k-z->k0+1) return FALSE;
+    if (memcmp(z->b+z->k-length+1,s+1,length) != 0) return FALSE;
+    z->j = z->k-length;
     return TRUE;
 }
 
 /* setto(s) sets (j+1),...k to the characters in the string s, readjusting
    k. */
 
-static void setto(char * s)
+static void setto(struct stemmer * z, char * s)
 {  int length = s[0];
-    memmove(b+j+1,s+1,length);
-    k = j+length;
+    memmove(z->b+z->j+1,s+1,length);
+    z->k = z->j+length;
 }
 
 /* r(s) is used further down. */
 
-static void r(char * s) { if (m() > 0) setto(s); }
+static void r(struct stemmer * z, char * s) { if (m(z) > 0) setto(z, s); }
 
 /* step1ab() gets rid of plurals and -ed or -ing. e.g.
 
@@ -179,71 +189,71 @@ static void r(char * s) { if (m() > 0) setto(s); }
 
 */
 
-static void step1ab()
-{  if (b[k] == 's')
-    {  if (ends("\04" "sses")) k -= 2; else
-        if (ends("\03" "ies")) setto("\01" "i"); else
-        if (b[k-1] != 's') k--;
+static void step1ab(struct stemmer * z)
+{  if (z->b[z->k] == 's')
+    {  if (ends(z, "\04" "sses")) z->k -= 2; else
+        if (ends(z, "\03" "ies")) setto(z, "\01" "i"); else
+        if (z->b[z->k-1] != 's') z->k--;
     }
-    if (ends("\03" "eed")) { if (m() > 0) k--; } else
-    if ((ends("\02" "ed") || ends("\03" "ing")) && vowelinstem())
-    {  k = j;
-        if (ends("\02" "at")) setto("\03" "ate"); else
-        if (ends("\02" "bl")) setto("\03" "ble"); else
-        if (ends("\02" "iz")) setto("\03" "ize"); else
-        if (doublec(k))
-        {  k--;
-            {  int ch = b[k];
-                if (ch == 'l' || ch == 's' || ch == 'z') k++;
+    if (ends(z, "\03" "eed")) { if (m(z) > 0) z->k--; } else
+    if ((ends(z, "\02" "ed") || ends(z, "\03" "ing")) && vowelinstem(z))
+    {  z->k = z->j;
+        if (ends(z, "\02" "at")) setto(z, "\03" "ate"); else
+        if (ends(z, "\02" "bl")) setto(z, "\03" "ble"); else
+        if (ends(z, "\02" "iz")) setto(z, "\03" "ize"); else
+        if (doublec(z, z->k))
+        {  z->k--;
+            {  int ch = z->b[z->k];
+                if (ch == 'l' || ch == 's' || ch == 'z') z->k++;
             }
         }
-        else if (m() == 1 && cvc(k)) setto("\01" "e");
+        else if (m(z) == 1 && cvc(z, z->k)) setto(z, "\01" "e");
     }
 }
 
 /* step1c() turns terminal y to i when there is another vowel in the stem. */
 
-static void step1c() { if (ends("\01" "y") && vowelinstem()) b[k] = 'i'; }
+static void step1c(struct stemmer * z) { if (ends(z, "\01" "y") && vowelinstem(z)) z->b[z->k] = 'i'; }
 
 
 /* step2() maps double suffices to single ones. so -ization ( = -ize plus
    -ation) maps to -ize etc. note that the string before the suffix must give
    m() > 0. */
 
-static void step2() { switch (b[k-1])
+static void step2(struct stemmer * z) { switch (z->b[z->k-1])
     {
-        case 'a': if (ends("\07" "ational")) { r("\03" "ate"); break; }
-            if (ends("\06" "tional")) { r("\04" "tion"); break; }
+        case 'a': if (ends(z, "\07" "ational")) { r(z, "\03" "ate"); break; }
+            if (ends(z, "\06" "tional")) { r(z, "\04" "tion"); break; }
             break;
-        case 'c': if (ends("\04" "enci")) { r("\04" "ence"); break; }
-            if (ends("\04" "anci")) { r("\04" "ance"); break; }
+        case 'c': if (ends(z, "\04" "enci")) { r(z, "\04" "ence"); break; }
+            if (ends(z, "\04" "anci")) { r(z, "\04" "ance"); break; }
             break;
-        case 'e': if (ends("\04" "izer")) { r("\03" "ize"); break; }
+        case 'e': if (ends(z, "\04" "izer")) { r(z, "\03" "ize"); break; }
             break;
-        case 'l': if (ends("\03" "bli")) { r("\03" "ble"); break; } /*-DEPARTURE-*/
+        case 'l': if (ends(z, "\03" "bli")) { r(z, "\03" "ble"); break; } /*-DEPARTURE-*/
 
             /* To match the published algorithm, replace this line with
                case 'l': if (ends("\04" "abli")) { r("\04" "able"); break; } */
 
-            if (ends("\04" "alli")) { r("\02" "al"); break; }
-            if (ends("\05" "entli")) { r("\03" "ent"); break; }
-            if (ends("\03" "eli")) { r("\01" "e"); break; }
-            if (ends("\05" "ousli")) { r("\03" "ous"); break; }
+            if (ends(z, "\04" "alli")) { r(z, "\02" "al"); break; }
+            if (ends(z, "\05" "entli")) { r(z, "\03" "ent"); break; }
+            if (ends(z, "\03" "eli")) { r(z, "\01" "e"); break; }
+            if (ends(z, "\05" "ousli")) { r(z, "\03" "ous"); break; }
             break;
-        case 'o': if (ends("\07" "ization")) { r("\03" "ize"); break; }
-            if (ends("\05" "ation")) { r("\03" "ate"); break; }
-            if (ends("\04" "ator")) { r("\03" "ate"); break; }
+        case 'o': if (ends(z, "\07" "ization")) { r(z, "\03" "ize"); break; }
+            if (ends(z, "\05" "ation")) { r(z, "\03" "ate"); break; }
+            if (ends(z, "\04" "ator")) { r(z, "\03" "ate"); break; }
             break;
-        case 's': if (ends("\05" "alism")) { r("\02" "al"); break; }
-            if (ends("\07" "iveness")) { r("\03" "ive"); break; }
-            if (ends("\07" "fulness")) { r("\03" "ful"); break; }
-            if (ends("\07" "ousness")) { r("\03" "ous"); break; }
+        case 's': if (ends(z, "\05" "alism")) { r(z, "\02" "al"); break; }
+            if (ends(z, "\07" "iveness")) { r(z, "\03" "ive"); break; }
+            if (ends(z, "\07" "fulness")) { r(z, "\03" "ful"); break; }
+            if (ends(z, "\07" "ousness")) { r(z, "\03" "ous"); break; }
             break;
-        case 't': if (ends("\05" "aliti")) { r("\02" "al"); break; }
-            if (ends("\05" "iviti")) { r("\03" "ive"); break; }
-            if (ends("\06" "biliti")) { r("\03" "ble"); break; }
+        case 't': if (ends(z, "\05" "aliti")) { r(z, "\02" "al"); break; }
+            if (ends(z, "\05" "iviti")) { r(z, "\03" "ive"); break; }
+            if (ends(z, "\06" "biliti")) { r(z, "\03" "ble"); break; }
             break;
-        case 'g': if (ends("\04" "logi")) { r("\03" "log"); break; } /*-DEPARTURE-*/
+        case 'g': if (ends(z, "\04" "logi")) { r(z, "\03" "log"); break; } /*-DEPARTURE-*/
 
             /* To match the published algorithm, delete this line */
 
@@ -251,60 +261,60 @@ static void step2() { switch (b[k-1])
 
 /* step3() deals with -ic-, -full, -ness etc. similar strategy to step2. */
 
-static void step3() { switch (b[k])
+static void step3(struct stemmer * z) { switch (z->b[z->k])
     {
-        case 'e': if (ends("\05" "icate")) { r("\02" "ic"); break; }
-            if (ends("\05" "ative")) { r("\00" ""); break; }
-            if (ends("\05" "alize")) { r("\02" "al"); break; }
+        case 'e': if (ends(z, "\05" "icate")) { r(z, "\02" "ic"); break; }
+            if (ends(z, "\05" "ative")) { r(z, "\00" ""); break; }
+            if (ends(z, "\05" "alize")) { r(z, "\02" "al"); break; }
             break;
-        case 'i': if (ends("\05" "iciti")) { r("\02" "ic"); break; }
+        case 'i': if (ends(z, "\05" "iciti")) { r(z, "\02" "ic"); break; }
             break;
-        case 'l': if (ends("\04" "ical")) { r("\02" "ic"); break; }
-            if (ends("\03" "ful")) { r("\00" ""); break; }
+        case 'l': if (ends(z, "\04" "ical")) { r(z, "\02" "ic"); break; }
+            if (ends(z, "\03" "ful")) { r(z, "\00" ""); break; }
             break;
-        case 's': if (ends("\04" "ness")) { r("\00" ""); break; }
+        case 's': if (ends(z, "\04" "ness")) { r(z, "\00" ""); break; }
             break;
     } }
 
 /* step4() takes off -ant, -ence etc., in context <c>vcvc<v>. */
 
-static void step4()
-{  switch (b[k-1])
-    {  case 'a': if (ends("\02" "al")) break; return;
-        case 'c': if (ends("\04" "ance")) break;
-            if (ends("\04" "ence")) break; return;
-        case 'e': if (ends("\02" "er")) break; return;
-        case 'i': if (ends("\02" "ic")) break; return;
-        case 'l': if (ends("\04" "able")) break;
-            if (ends("\04" "ible")) break; return;
-        case 'n': if (ends("\03" "ant")) break;
-            if (ends("\05" "ement")) break;
-            if (ends("\04" "ment")) break;
-            if (ends("\03" "ent")) break; return;
-        case 'o': if (ends("\03" "ion") && j >= k0 && (b[j] == 's' || b[j] == 't')) break;
-            if (ends("\02" "ou")) break; return;
+static void step4(struct stemmer * z)
+{  switch (z->b[z->k-1])
+    {  case 'a': if (ends(z, "\02" "al")) break; return;
+        case 'c': if (ends(z, "\04" "ance")) break;
+            if (ends(z, "\04" "ence")) break; return;
+        case 'e': if (ends(z, "\02" "er")) break; return;
+        case 'i': if (ends(z, "\02" "ic")) break; return;
+        case 'l': if (ends(z, "\04" "able")) break;
+            if (ends(z, "\04" "ible")) break; return;
+        case 'n': if (ends(z, "\03" "ant")) break;
+            if (ends(z, "\05" "ement")) break;
+            if (ends(z, "\04" "ment")) break;
+            if (ends(z, "\03" "ent")) break; return;
+        case 'o': if (ends(z, "\03" "ion") && z->j >= z->k0 && (z->b[z->j] == 's' || z->b[z->j] == 't')) break;
+            if (ends(z, "\02" "ou")) break; return;
             /* takes care of -ous */
-        case 's': if (ends("\03" "ism")) break; return;
-        case 't': if (ends("\03" "ate")) break;
-            if (ends("\03" "iti")) break; return;
-        case 'u': if (ends("\03" "ous")) break; return;
-        case 'v': if (ends("\03" "ive")) break; return;
-        case 'z': if (ends("\03" "ize")) break; return;
+        case 's': if (ends(z, "\03" "ism")) break; return;
+        case 't': if (ends(z, "\03" "ate")) break;
+            if (ends(z, "\03" "iti")) break; return;
+        case 'u': if (ends(z, "\03" "ous")) break; return;
+        case 'v': if (ends(z, "\03" "ive")) break; return;
+        case 'z': if (ends(z, "\03" "ize")) break; return;
         default: return;
     }
-    if (m() > 1) k = j;
+    if (m(z) > 1) z->k = z->j;
 }
 
 /* step5() removes a final -e if m() > 1, and changes -ll to -l if
    m() > 1. */
 
-static void step5()
-{  j = k;
-    if (b[k] == 'e')
-    {  int a = m();
-        if (a > 1 || a == 1 && !cvc(k-1)) k--;
+static void step5(struct stemmer * z)
+{  z->j = z->k;
+    if (z->b[z->k] == 'e')
+    {  int a = m(z);
+        if (a > 1 || a == 1 && !cvc(z, z->k-1)) z->k--;
     }
-    if (b[k] == 'l' && doublec(k) && m() > 1) k--;
+    if (z->b[z->k] == 'l' && doublec(z, z->k) && m(z) > 1) z->k--;
 }
 
 /* In stem(p,i,j), p is a char pointer, and the string to be stemmed is from
@@ -317,17 +327,18 @@ static void step5()
 */
 
 int stem(char * p, int i, int j)
-{  b = p; k = j; k0 = i; /* copy the parameters into statics */
-    if (k <= k0+1) return k; /*-DEPARTURE-*/
+{  struct stemmer z;
+    z.b = p; z.k = j; z.k0 = i; /* copy the parameters into the context */
+    if (z.k <= z.k0+1) return z.k; /*-DEPARTURE-*/
 
     /* With this line, strings of length 1 or 2 don't go through the
        stemming process, although no mention is made of this in the
        published algorithm. Remove the line to match the published
        algorithm. */
 
-    step1ab();
-    if (k > k0) {
-        step1c(); step2(); step3(); step4(); step5();
+    step1ab(&z);
+    if (z.k > z.k0) {
+        step1c(&z); step2(&z); step3(&z); step4(&z); step5(&z);
     }
-    return k;
+    return z.k;
 }
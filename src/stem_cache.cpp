@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stem_cache.hpp"
+#include <cstring>
+
+ir::StemCache::StemCache(size_t capacity) {
+    if (capacity == 0) {
+        return;
+    }
+    size_t n_entries = 1;
+    while (n_entries < capacity) {
+        n_entries <<= 1;
+    }
+    m_entries.resize(n_entries);
+}
+
+ir::StemCache::key_t ir::StemCache::make_key(std::string_view word) {
+    key_t key = {};
+    key.bytes[0] = static_cast<char>(word.size());
+    std::memcpy(key.bytes + 1, word.data(), word.size());
+    return key;
+}
+
+size_t ir::StemCache::home_of(const key_t& key) const {
+    // multiply-xorshift mix of the words of the key
+    std::uint64_t hash = 0;
+    for (size_t i = 0; i < sizeof(key.bytes); i += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, key.bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+    return static_cast<size_t>(hash) & (m_entries.size() - 1);
+}
+
+bool ir::StemCache::find(std::string& word) const {
+    if (m_entries.empty() || word.empty() || word.size() > MaxWordSize) {
+        return false;
+    }
+
+    const key_t key = make_key(word);
+    const size_t mask = m_entries.size() - 1;
+    const size_t home = home_of(key);
+    for (size_t i = 0; i < ProbeLength; ++i) {
+        const entry& e = m_entries[(home + i) & mask];
+        if (std::memcmp(e.word.bytes, key.bytes, sizeof(key.bytes)) == 0) {
+            word.assign(e.stem.bytes + 1,
+                        static_cast<unsigned char>(e.stem.bytes[0]));
+            return true;
+        }
+    }
+    return false;
+}
+
+void ir::StemCache::insert(std::string_view word, std::string_view stem) {
+    if (m_entries.empty() || word.empty() || word.size() > MaxWordSize ||
+        stem.size() > MaxWordSize) {
+        return;
+    }
+
+    // store in the first empty or matching entry of the probe window;
+    // otherwise, replace the word in the home entry
+    const key_t key = make_key(word);
+    const size_t mask = m_entries.size() - 1;
+    const size_t home = home_of(key);
+    entry* target = &m_entries[home];
+    for (size_t i = 0; i < ProbeLength; ++i) {
+        entry& e = m_entries[(home + i) & mask];
+        if (e.word.bytes[0] == 0 ||
+            std::memcmp(e.word.bytes, key.bytes, sizeof(key.bytes)) == 0) {
+            target = &e;
+            break;
+        }
+    }
+
+    if (target->word.bytes[0] == 0) {
+        ++m_size;
+    }
+    target->word = key;
+    target->stem = make_key(stem);
+}
+
+size_t ir::StemCache::size() const { return m_size; }
+
+std::vector<std::string> ir::StemCache::words() const {
+    std::vector<std::string> result;
+    result.reserve(m_size);
+    for (const entry& e : m_entries) {
+        if (e.word.bytes[0] != 0) {
+            result.emplace_back(e.word.bytes + 1,
+                                static_cast<unsigned char>(e.word.bytes[0]));
+        }
+    }
+    return result;
+}
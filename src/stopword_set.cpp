@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stopword_set.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+/**
+ * @brief Number of displacements tried for a bucket before giving up.
+ */
+static constexpr std::uint32_t MaxDisplacement = 1u << 24;
+
+ir::StopwordSet::StopwordSet(std::vector<std::string> words) {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.empty()) {
+        return;
+    }
+
+    // about two words per bucket keeps the search for displacements short
+    const size_t n_words = words.size();
+    const size_t n_buckets = (n_words + 1) / 2;
+    m_displacements.assign(n_buckets, 0);
+    m_words.resize(n_words);
+
+    std::vector<std::uint64_t> hashes(n_words);
+    std::vector<std::vector<size_t>> buckets(n_buckets);
+    for (size_t i = 0; i < n_words; ++i) {
+        hashes[i] = fnv1a_hash(words[i].data(), words[i].size());
+        buckets[hashes[i] % n_buckets].push_back(i);
+    }
+
+    // place the largest buckets first while most of the slots are free
+    std::vector<size_t> order(n_buckets);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<bool> taken(n_words, false);
+    std::vector<size_t> slots;
+    for (const size_t bucket : order) {
+        const auto& members = buckets[bucket];
+        if (members.empty()) {
+            break;
+        }
+
+        std::uint32_t displacement = 0;
+        for (;; ++displacement) {
+            if (displacement == MaxDisplacement) {
+                throw std::runtime_error("Cannot build a perfect hash of " +
+                                         std::to_string(n_words) + " words");
+            }
+            slots.clear();
+            for (const size_t i : members) {
+                const size_t slot = slot_of(hashes[i], displacement);
+                if (taken[slot] || std::find(slots.begin(), slots.end(),
+                                             slot) != slots.end()) {
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (slots.size() == members.size()) {
+                break;
+            }
+        }
+
+        m_displacements[bucket] = displacement;
+        for (size_t k = 0; k < members.size(); ++k) {
+            taken[slots[k]] = true;
+            m_words[slots[k]] = std::move(words[members[k]]);
+        }
+    }
+}
+
+size_t ir::StopwordSet::slot_of(std::uint64_t hash,
+                                std::uint32_t displacement) const {
+    // splitmix64 finalizer of the hash offset by the displacement
+    std::uint64_t x = hash + (displacement + 1) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<size_t>(x % m_words.size());
+}
+
+bool ir::StopwordSet::contains(std::string_view word) const {
+    if (m_words.empty()) {
+        return false;
+    }
+
+    const std::uint64_t hash = fnv1a_hash(word.data(), word.size());
+    const size_t slot =
+        slot_of(hash, m_displacements[hash % m_displacements.size()]);
+    return m_words[slot] == word;
+}
+
+size_t ir::StopwordSet::size() const { return m_words.size(); }
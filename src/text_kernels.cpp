@@ -0,0 +1,264 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "text_kernels.hpp"
+
+#include <array>
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define IR_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Check whether the given character is dropped by ir::fold_text.
+ *
+ * @param c Character to check.
+ *
+ * @return true if c is dropped; false, otherwise.
+ */
+static bool is_dropped(char c) {
+    return c == '\"' || c == ',' || c == '<' || c == '>' || c == '\'';
+}
+
+/**
+ * @brief Portable text folding kernel.
+ *
+ * @param src Text to fold.
+ * @param size Number of characters in src.
+ * @param dst Output buffer.
+ *
+ * @return Number of characters written to dst.
+ */
+static size_t fold_text_scalar(const char* src, size_t size, char* dst) {
+    size_t n = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const char c = src[i];
+        if (!is_dropped(c)) {
+            dst[n++] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c;
+        }
+    }
+    return n;
+}
+
+#ifdef IR_X86_KERNELS
+/**
+ * @brief Table of byte shuffles that move the bytes of an 8 byte lane selected
+ * by the bits of the index to the beginning of the lane, in order.
+ */
+struct pack_table {
+    std::array<std::uint64_t, 256> shuffles{};
+
+    constexpr pack_table() {
+        for (unsigned mask = 0; mask < 256; ++mask) {
+            std::uint64_t shuffle = 0;
+            unsigned n = 0;
+            for (unsigned bit = 0; bit < 8; ++bit) {
+                if (mask & (1u << bit)) {
+                    shuffle |= static_cast<std::uint64_t>(bit) << (8 * n++);
+                }
+            }
+            shuffles[mask] = shuffle;
+        }
+    }
+};
+
+static constexpr pack_table PackTable;
+
+/**
+ * @brief Classify the given 16 bytes and return them lowercased, together with
+ * the mask of the bytes to keep.
+ *
+ * Bytes are compared as signed characters; hence, bytes above 0x7f are never
+ * lowercased, as in the scalar kernel.
+ *
+ * @param v Bytes to classify.
+ * @param keep Mask of the bytes that are not dropped.
+ *
+ * @return Lowercased bytes.
+ */
+__attribute__((target("sse4.2,popcnt"))) static inline __m128i
+classify_sse42(__m128i v, unsigned& keep) {
+    const __m128i dropped = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8(','))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('>'))),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\''))));
+    keep = ~static_cast<unsigned>(_mm_movemask_epi8(dropped)) & 0xffffu;
+
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                        _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), v));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+/**
+ * @brief Write the bytes of the given 16 bytes selected by the given mask to
+ * the given buffer, in order.
+ *
+ * Two 8 byte stores are made; hence, up to 16 bytes starting at dst are
+ * overwritten even if fewer bytes are kept.
+ *
+ * @param v Bytes to pack.
+ * @param keep Mask of the bytes to write.
+ * @param dst Output buffer.
+ *
+ * @return Number of bytes written.
+ */
+__attribute__((target("sse4.2,popcnt"))) static inline size_t
+pack_sse42(__m128i v, unsigned keep, char* dst) {
+    const unsigned keep_lo = keep & 0xffu;
+    const unsigned keep_hi = keep >> 8;
+    // indices of the upper lane are offset by 8
+    const __m128i shuffle = _mm_set_epi64x(
+        static_cast<long long>(PackTable.shuffles[keep_hi] +
+                               0x0808080808080808ULL),
+        static_cast<long long>(PackTable.shuffles[keep_lo]));
+    const __m128i packed = _mm_shuffle_epi8(v, shuffle);
+
+    const size_t n_lo = static_cast<size_t>(_mm_popcnt_u32(keep_lo));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + n_lo),
+                     _mm_srli_si128(packed, 8));
+    return n_lo + static_cast<size_t>(_mm_popcnt_u32(keep_hi));
+}
+
+/**
+ * @brief SSE4.2 text folding kernel.
+ *
+ * Each block of 16 bytes is classified and lowercased in a single register and
+ * its kept bytes are packed with one byte shuffle.
+ *
+ * @param src Text to fold.
+ * @param size Number of characters in src.
+ * @param dst Output buffer.
+ *
+ * @return Number of characters written to dst.
+ */
+__attribute__((target("sse4.2,popcnt"))) static size_t
+fold_text_sse42(const char* src, size_t size, char* dst) {
+    // no more than 16 bytes are written from the output position, which
+    // never passes the input position; hence, dst is never overrun
+    size_t n = 0;
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        unsigned keep;
+        const __m128i lower = classify_sse42(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), keep);
+        if (keep == 0xffffu) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + n), lower);
+            n += 16;
+        } else {
+            n += pack_sse42(lower, keep, dst + n);
+        }
+    }
+    return n + fold_text_scalar(src + i, size - i, dst + n);
+}
+
+/**
+ * @brief AVX2 text folding kernel.
+ *
+ * Each block of 32 bytes is classified and lowercased in a single register.
+ * Blocks without dropped characters, the common case in running text, are
+ * stored as they are; otherwise, each half is packed as in the SSE4.2 kernel.
+ *
+ * @param src Text to fold.
+ * @param size Number of characters in src.
+ * @param dst Output buffer.
+ *
+ * @return Number of characters written to dst.
+ */
+__attribute__((target("avx2,popcnt"))) static size_t
+fold_text_avx2(const char* src, size_t size, char* dst) {
+    size_t n = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i dropped = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>'))),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\''))));
+        const unsigned keep = ~static_cast<unsigned>(_mm256_movemask_epi8(dropped));
+
+        const __m256i upper = _mm256_and_si256(
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+        const __m256i lower =
+            _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+
+        if (keep == 0xffffffffu) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + n), lower);
+            n += 32;
+        } else {
+            n += pack_sse42(_mm256_castsi256_si128(lower), keep & 0xffffu,
+                            dst + n);
+            n += pack_sse42(_mm256_extracti128_si256(lower, 1), keep >> 16,
+                            dst + n);
+        }
+    }
+    return n + fold_text_sse42(src + i, size - i, dst + n);
+}
+#endif
+
+ir::TextKernel ir::detect_text_kernel() {
+#ifdef IR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return TextKernel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        return TextKernel::SSE42;
+    }
+#endif
+    return TextKernel::Scalar;
+}
+
+std::string ir::to_string(ir::TextKernel kernel) {
+    switch (kernel) {
+    case ir::TextKernel::Scalar:
+        return "scalar";
+    case ir::TextKernel::SSE42:
+        return "sse4.2";
+    case ir::TextKernel::AVX2:
+        return "avx2";
+    }
+    return "";
+}
+
+size_t ir::fold_text(const char* src, size_t size, char* dst) {
+    // CPU features are checked only once
+    static const TextKernel kernel = detect_text_kernel();
+    return fold_text(src, size, dst, kernel);
+}
+
+size_t ir::fold_text(const char* src, size_t size, char* dst,
+                     TextKernel kernel) {
+    switch (kernel) {
+#ifdef IR_X86_KERNELS
+    case TextKernel::AVX2:
+        return fold_text_avx2(src, size, dst);
+    case TextKernel::SSE42:
+        return fold_text_sse42(src, size, dst);
+#endif
+    default:
+        return fold_text_scalar(src, size, dst);
+    }
+}
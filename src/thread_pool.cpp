@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pool.hpp"
+
+ir::ThreadPool::ThreadPool(size_t n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    // calling thread is the last thread of the pool
+    for (size_t i = 1; i < n_threads; ++i) {
+        m_workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ir::ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_task_ready.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+size_t ir::ThreadPool::size() const { return m_workers.size() + 1; }
+
+void ir::ThreadPool::run_chunks(ForState& state) {
+    size_t chunk;
+    while ((chunk = state.next_chunk++) < state.n_chunks) {
+        const size_t beg = chunk * state.chunk_size;
+        const size_t end = std::min(beg + state.chunk_size, state.n);
+
+        std::exception_ptr error;
+        try {
+            state.func(beg, end);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (error && !state.error) {
+            state.error = error;
+        }
+        if (++state.finished_chunks == state.n_chunks) {
+            state.done.notify_all();
+        }
+    }
+}
+
+void ir::ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_task_ready.wait(lock,
+                              [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
@@ -15,8 +15,11 @@
  */
 
 #include "tokenizer.hpp"
+#include "porter_stemmer.hpp"
+#include "text_kernels.hpp"
 #include "util.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <file_manager.hpp>
@@ -24,76 +27,230 @@
 #include <iostream>
 #include <numeric>
 
-// tell the compiler that stem will be externally linked
-extern int stem(char* p, int i, int j);
+/**
+ * @brief Return a new unique id for a tokenizer.
+ *
+ * Ids are never reused; hence, a thread never mistakes the memo table of a
+ * destroyed tokenizer for the table of a new one at the same address.
+ *
+ * @return Tokenizer id.
+ */
+static size_t next_tokenizer_id() {
+    static std::atomic<size_t> next_id{0};
+    return next_id++;
+}
+
+/**
+ * @brief Copy the given token to the given buffer with its punctuation
+ * characters removed as specified in ir::Tokenizer::normalize.
+ *
+ * @param token Input token from which punctuation will be removed.
+ * @param result Buffer to store the token without punctuation.
+ */
+static void strip_punctuation(std::string_view token, std::string& result) {
+    // remove certain puncts from anywhere in the word
+    result.clear();
+    for (const char c : token) {
+        if (c != '\"' && c != ',' && c != '<' && c != '>' && c != '\'') {
+            result.push_back(c);
+        }
+    }
+
+    // remove any kind of punct from the start and end of the word
+    auto is_kept = [](const char c) { return isalnum(c) != 0; };
+    const auto last = std::find_if(result.rbegin(), result.rend(), is_kept);
+    result.erase(last.base(), result.end());
+    const auto first = std::find_if(result.begin(), result.end(), is_kept);
+    result.erase(result.begin(), first);
+}
+
+/**
+ * @brief Read the whitespace separated words in ir::STOPWORD_PATH.
+ *
+ * @return Stopwords in the file.
+ */
+static std::vector<std::string> read_stopwords() {
+    std::vector<std::string> result;
+    std::ifstream ifs(ir::STOPWORD_PATH);
+    std::string stopword;
+    while (ifs >> stopword) {
+        result.push_back(stopword);
+    }
+    assert(!result.empty());
+
+    return result;
+}
+
+/**
+ * @brief Return the given folded token without the punctuation characters at
+ * its beginning and at its end.
+ *
+ * @param token Token folded with ir::fold_text.
+ *
+ * @return View of token without leading and trailing punctuation.
+ */
+static std::string_view trim_punctuation(std::string_view token) {
+    // same as isalnum in the C locale, for which folded tokens are lowercase
+    auto is_kept = [](const char c) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+               (c >= 'A' && c <= 'Z');
+    };
+    size_t beg = 0;
+    size_t end = token.size();
+    while (beg != end && !is_kept(token[beg])) {
+        ++beg;
+    }
+    while (end != beg && !is_kept(token[end - 1])) {
+        --end;
+    }
+    return token.substr(beg, end - beg);
+}
+
+ir::Tokenizer::Tokenizer()
+    : m_stopwords(read_stopwords()), m_id(next_tokenizer_id()) {}
 
 std::vector<std::string>
 ir::Tokenizer::tokenize(const std::string& str) {
-    std::string str_copy(str);
+    std::vector<std::string> result;
+    const char* pos = str.data();
+    const char* end = pos + str.size();
+    for (auto token = next_token(pos, end); !token.empty();
+         token = next_token(pos, end)) {
+        result.emplace_back(token);
+    }
 
-    return split(str_copy, " \t\n\r\v\f");
+    return result;
 }
 
 std::string ir::Tokenizer::remove_punctuation(const std::string& token) {
-    std::string result(token);
+    std::string result;
+    strip_punctuation(token, result);
 
-    // remove certain puncts from anywhere in the word
-    std::replace(result.begin(), result.end(), '\"', '\'');
-    std::replace(result.begin(), result.end(), ',', '\'');
-    std::replace(result.begin(), result.end(), '<', '\'');
-    std::replace(result.begin(), result.end(), '>', '\'');
-    result.erase(std::remove(result.begin(), result.end(), '\''), result.end());
+    return result;
+}
+
+bool ir::Tokenizer::is_stopword(std::string_view word) const {
+    return m_stopwords.contains(word);
+}
 
-    if (result.empty()) {
-        return result;
+std::string ir::Tokenizer::normalize(const std::string& token) {
+    std::string result;
+    if (!normalize(std::string_view(token), result)) {
+        return "";
     }
 
-    // iterate as long as current char is not alphanumeric and not '
-    // (' will be removed)
-    auto to_remove = [](const char c) { return c != '\'' && !isalnum(c); };
-    // remove any kind of punct from the start and end of the word
-    for (size_t i = 0; to_remove(result[i]); ++i) {
-        result[i] = '\'';
+    return result;
+}
+
+bool ir::Tokenizer::normalize(std::string_view token, std::string& term) {
+    // remove punctuation from anywhere in the token and convert it to lowercase
+    thread_local std::string folded;
+    folded.resize(token.size());
+    folded.resize(fold_text(token.data(), token.size(), &folded[0]));
+
+    return normalize_folded(folded, term);
+}
+
+bool ir::Tokenizer::normalize_folded(std::string_view token,
+                                     std::string& term) {
+    // remove punctuation from the start and end of the token
+    const std::string_view word = trim_punctuation(token);
+    if (word.empty()) {
+        return false;
     }
-    for (size_t i = result.size() - 1; to_remove(result[i]); --i) {
-        result[i] = '\'';
+    // if string is a stopword, there is no term
+    if (is_stopword(word)) {
+        return false;
     }
-    result.erase(std::remove(result.begin(), result.end(), '\''), result.end());
+    // stem the word
+    term.assign(word);
+    stem_word(term);
 
-    return result;
+    return true;
 }
 
-bool ir::Tokenizer::is_stopword(const std::string& word) {
-    static std::vector<std::string> stopwords;
+ir::Tokenizer::thread_stem_cache& ir::Tokenizer::thread_cache() {
+    // tables of every tokenizer used by this thread, and the last one used
+    thread_local std::unordered_map<size_t, thread_stem_cache*> tables;
+    thread_local size_t last_id = SIZE_MAX;
+    thread_local thread_stem_cache* last = nullptr;
+    if (last_id == m_id) {
+        return *last;
+    }
 
-    // if calling for the first time
-    if (stopwords.empty()) {
-        std::ifstream ifs(ir::STOPWORD_PATH);
-        std::string stopword;
-        while (ifs >> stopword) {
-            stopwords.push_back(stopword);
-        }
-        assert(!stopwords.empty());
+    auto& table = tables[m_id];
+    if (table == nullptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_caches.push_back(std::make_unique<thread_stem_cache>());
+        table = m_caches.back().get();
+    }
+    last_id = m_id;
+    last = table;
+    return *last;
+}
 
-        std::sort(stopwords.begin(), stopwords.end());
+void ir::Tokenizer::stem_word(std::string& word) {
+    thread_stem_cache& local = thread_cache();
+    if (m_preloaded.find(word) || local.cache.find(word)) {
+        ++local.stats.hits;
+        return;
     }
+    ++local.stats.misses;
 
-    return std::binary_search(stopwords.begin(), stopwords.end(), word);
+    thread_local std::string original;
+    original = word;
+    const int word_end = stem(&word[0], 0, static_cast<int>(word.size()) - 1);
+    word.resize(static_cast<size_t>(word_end) + 1);
+    local.cache.insert(original, word);
 }
 
-std::string ir::Tokenizer::normalize(const std::string& token) {
-    // remove punctuation using heuristics
-    std::string result = remove_punctuation(token);
-    // convert string to lowercase
-    std::transform(result.begin(), result.end(), result.begin(), tolower);
-    // if string is a stopword, return empty string
-    if (is_stopword(result)) {
-        return "";
+size_t ir::Tokenizer::preload_stems(std::istream& is) {
+    std::vector<std::string> words = m_preloaded.words();
+    const size_t n_loaded = words.size();
+    std::string word;
+    while (is >> word) {
+        words.push_back(word);
+    }
+
+    // keep the table at most half full so that probe windows rarely overflow
+    m_preloaded = StemCache(2 * words.size());
+    std::string stemmed;
+    for (const auto& w : words) {
+        stemmed = w;
+        const int word_end =
+            stem(&stemmed[0], 0, static_cast<int>(stemmed.size()) - 1);
+        stemmed.resize(static_cast<size_t>(word_end) + 1);
+        m_preloaded.insert(w, stemmed);
     }
-    // stem the word
-    auto word_end = static_cast<size_t>(stem(&result[0], 0, result.size() - 1));
-    result = result.substr(0, word_end + 1);
 
+    return words.size() - n_loaded;
+}
+
+std::ostream& ir::Tokenizer::save_stems(std::ostream& os) const {
+    std::vector<std::string> words = m_preloaded.words();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& local : m_caches) {
+            const auto local_words = local->cache.words();
+            words.insert(words.end(), local_words.begin(), local_words.end());
+        }
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    for (const auto& word : words) {
+        os << word << '\n';
+    }
+    return os;
+}
+
+ir::stem_cache_stats ir::Tokenizer::stem_stats() const {
+    stem_cache_stats result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& local : m_caches) {
+        result.hits += local->stats.hits;
+        result.misses += local->stats.misses;
+    }
     return result;
 }
 
@@ -109,19 +266,40 @@ void ir::Tokenizer::normalize_all(std::vector<std::string>& token_vec) {
 
 ir::doc_sample
 ir::Tokenizer::get_doc_terms(const raw_doc& doc) {
-    auto tokens = tokenize(doc);
+    thread_local std::string folded;
+    thread_local std::string term;
+    folded.resize(doc.size());
+    folded.resize(fold_text(doc.data(), doc.size(), &folded[0]));
 
-    normalize_all(tokens);
-
-    if (tokens.empty()) {
-        return {};
+    doc_sample result;
+    const char* pos = folded.data();
+    const char* end = pos + folded.size();
+    for (auto token = next_token(pos, end); !token.empty();
+         token = next_token(pos, end)) {
+        if (normalize_folded(token, term)) {
+            // term is copied only when it is inserted
+            ++result[term];
+        }
     }
 
-    std::sort(tokens.begin(), tokens.end());
+    return result;
+}
+
+ir::id_sample ir::Tokenizer::get_doc_terms(const raw_doc& doc,
+                                           Vocabulary& vocab) {
+    thread_local std::string folded;
+    thread_local std::string term;
+    folded.resize(doc.size());
+    folded.resize(fold_text(doc.data(), doc.size(), &folded[0]));
 
-    doc_sample result;
-    for (const auto& term : tokens) {
-        ++result[term];
+    id_sample result;
+    const char* pos = folded.data();
+    const char* end = pos + folded.size();
+    for (auto token = next_token(pos, end); !token.empty();
+         token = next_token(pos, end)) {
+        if (normalize_folded(token, term)) {
+            ++result[vocab.intern(term)];
+        }
     }
 
     return result;
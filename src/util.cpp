@@ -31,3 +31,30 @@ std::vector<std::string> ir::split(std::string& str,
 
     return result;
 }
+
+std::uint64_t ir::fnv1a_hash(const char* data, size_t size) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool ir::parse_size(std::string_view str, size_t& value) {
+    if (str.empty()) {
+        return false;
+    }
+
+    size_t result = 0;
+    for (const char c : str) {
+        const auto digit = static_cast<unsigned char>(c - '0');
+        if (digit > 9) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+
+    value = result;
+    return true;
+}
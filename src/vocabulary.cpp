@@ -0,0 +1,62 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vocabulary.hpp"
+
+constexpr ir::term_id ir::Vocabulary::npos;
+
+ir::term_id ir::Vocabulary::intern(std::string_view term) {
+    const auto it = m_ids.find(term);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+
+    // term is seen for the first time; key the index by the stored copy
+    const auto next_id = static_cast<term_id>(m_terms.size());
+    m_terms.emplace_back(term);
+    m_ids.emplace(m_terms.back(), next_id);
+
+    return next_id;
+}
+
+ir::term_id ir::Vocabulary::find(std::string_view term) const {
+    const auto it = m_ids.find(term);
+    return it != m_ids.end() ? it->second : npos;
+}
+
+const std::string& ir::Vocabulary::term(term_id id) const {
+    return m_terms[id];
+}
+
+size_t ir::Vocabulary::size() const { return m_terms.size(); }
+
+ir::id_sample ir::Vocabulary::to_ids(const doc_sample& doc) {
+    id_sample result;
+    result.reserve(doc.size());
+    for (const auto& pair : doc) {
+        result[intern(pair.first)] = pair.second;
+    }
+    return result;
+}
+
+ir::doc_sample ir::Vocabulary::to_terms(const id_sample& doc) const {
+    doc_sample result;
+    result.reserve(doc.size());
+    for (const auto& pair : doc) {
+        result[term(pair.first)] = pair.second;
+    }
+    return result;
+}
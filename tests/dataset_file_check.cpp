@@ -0,0 +1,201 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief Check that corrupt binary dataset files are rejected.
+ *
+ * A small dataset is written with ir::write_binary_dataset and read back, and
+ * then copies of it with a truncated body, out of bounds or misaligned
+ * sections, unsorted offsets and out of range term ids are opened. Every
+ * corrupt copy must be rejected by ir::DatasetFile with std::runtime_error.
+ */
+
+#include "dataset_file.hpp"
+#include "vocabulary.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Path of the dataset files written by this check.
+ */
+static const std::string CheckPath = "dataset_file_check.bin";
+
+/**
+ * @brief Write the given bytes to ir::CheckPath.
+ *
+ * @param bytes Contents of the file.
+ */
+static void write_file(const std::string& bytes) {
+    std::ofstream ofs(CheckPath, std::ios::binary | std::ios::trunc);
+    ofs.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+/**
+ * @brief Read the 64-bit value at the given file offset.
+ *
+ * @param bytes Contents of a binary dataset file.
+ * @param offset Offset of the value in the file.
+ *
+ * @return Value of the field.
+ */
+static std::uint64_t get(const std::string& bytes, size_t offset) {
+    std::uint64_t value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Overwrite the 64-bit value at the given file offset.
+ *
+ * @param bytes Contents of a binary dataset file.
+ * @param offset Offset of the value in the file.
+ * @param value New value.
+ */
+static void set(std::string& bytes, size_t offset, std::uint64_t value) {
+    std::memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+/**
+ * @brief Overwrite the 32-bit value at the given file offset.
+ *
+ * @param bytes Contents of a binary dataset file.
+ * @param offset Offset of the value in the file.
+ * @param value New value.
+ */
+static void set32(std::string& bytes, size_t offset, std::uint32_t value) {
+    std::memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+int main() {
+    ir::Vocabulary vocab;
+    ir::id_term_index docs;
+    ir::doc_class_index classes;
+    docs[1][vocab.intern("grain")] = 2;
+    docs[1][vocab.intern("wheat")] = 1;
+    docs[2][vocab.intern("oil")] = 3;
+    docs[3];
+    classes[1] = ir::DocClass::Grain;
+    classes[2] = ir::DocClass::Crude;
+    classes[3] = ir::DocClass::Other;
+
+    std::ostringstream oss;
+    ir::write_binary_dataset(oss, docs, classes, vocab);
+    const std::string valid = oss.str();
+
+    size_t n_failed = 0;
+    const auto expect = [&n_failed](const std::string& name, bool valid_file) {
+        bool accepted = true;
+        try {
+            ir::DatasetFile dataset(CheckPath);
+            ir::Vocabulary read_vocab;
+            ir::read_dataset(dataset, read_vocab);
+        } catch (const std::runtime_error&) {
+            accepted = false;
+        }
+        if (accepted != valid_file) {
+            std::cerr << name << ": expected the file to be "
+                      << (valid_file ? "accepted" : "rejected") << std::endl;
+            ++n_failed;
+        }
+    };
+    // apply a corruption to a copy of the valid file and expect a rejection
+    const auto corrupt = [&](const std::string& name,
+                             const std::function<void(std::string&)>& modify) {
+        std::string bytes = valid;
+        modify(bytes);
+        write_file(bytes);
+        expect(name, false);
+    };
+
+    using header = ir::binary_dataset_header;
+    const std::uint64_t n_entries = get(valid, offsetof(header, n_entries));
+    const std::uint64_t n_terms = get(valid, offsetof(header, n_terms));
+    const std::uint64_t term_ids = get(valid, offsetof(header, term_ids_offset));
+    const std::uint64_t doc_offsets =
+        get(valid, offsetof(header, doc_offsets_offset));
+    const std::uint64_t str_offsets =
+        get(valid, offsetof(header, string_offsets_offset));
+
+    write_file(valid);
+    expect("valid file", true);
+
+    corrupt("truncated", [](std::string& b) {
+        b.resize(b.size() - 8);
+        set(b, offsetof(header, file_size), b.size());
+    });
+    corrupt("too many documents", [](std::string& b) {
+        set(b, offsetof(header, n_docs), get(b, offsetof(header, n_docs)) + 1);
+    });
+    corrupt("huge number of documents", [](std::string& b) {
+        set(b, offsetof(header, n_docs), ~std::uint64_t(0) / 2);
+    });
+    corrupt("too many entries", [n_entries](std::string& b) {
+        set(b, offsetof(header, n_entries), n_entries + 1);
+    });
+    corrupt("too many terms", [](std::string& b) {
+        set(b, offsetof(header, n_terms), get(b, offsetof(header, n_terms)) + 1);
+    });
+    const size_t offset_fields[] = {
+        offsetof(header, ids_offset),         offsetof(header, classes_offset),
+        offsetof(header, doc_offsets_offset), offsetof(header, term_ids_offset),
+        offsetof(header, counts_offset),
+        offsetof(header, string_offsets_offset),
+        offsetof(header, string_data_offset)};
+    for (const size_t offset : offset_fields) {
+        const std::string name = "section at header offset " +
+                                 std::to_string(offset);
+        corrupt(name + " out of bounds", [offset](std::string& b) {
+            set(b, offset, b.size());
+        });
+        corrupt(name + " past the end", [offset](std::string& b) {
+            set(b, offset, ~std::uint64_t(0) - 7);
+        });
+    }
+    corrupt("misaligned document offsets", [](std::string& b) {
+        set(b, offsetof(header, doc_offsets_offset),
+            get(b, offsetof(header, doc_offsets_offset)) + 1);
+    });
+    corrupt("unsorted document offsets", [doc_offsets](std::string& b) {
+        set(b, doc_offsets + 8, 5);
+    });
+    corrupt("document offsets not ending at the entries",
+            [doc_offsets](std::string& b) { set(b, doc_offsets + 3 * 8, 1); });
+    corrupt("term offsets past the string data",
+            [str_offsets, n_terms](std::string& b) {
+                set(b, str_offsets + n_terms * 8, b.size());
+            });
+    corrupt("unsorted term offsets", [str_offsets](std::string& b) {
+        set(b, str_offsets + 8, 1000);
+    });
+    corrupt("out of range term id", [term_ids, n_terms](std::string& b) {
+        set32(b, term_ids, static_cast<std::uint32_t>(n_terms));
+    });
+
+    std::remove(CheckPath.c_str());
+    if (n_failed != 0) {
+        std::cerr << n_failed << " corrupt dataset checks failed" << std::endl;
+        return 1;
+    }
+    std::cerr << "every corrupt dataset was rejected" << std::endl;
+    return 0;
+}
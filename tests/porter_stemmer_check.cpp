@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018 Esref Ozdemir
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief Differential check of the reentrant Porter stemmer.
+ *
+ * Every word in the reference list given as the only argument is stemmed
+ * serially and then concurrently by the threads of an ir::ThreadPool, and the
+ * stems are compared with the reference stems byte for byte. The reference
+ * list holds one "<word> <stem>" pair per line, stemmed by the original
+ * single threaded stemmer.
+ */
+
+#include "porter_stemmer.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Number of threads stemming the words concurrently.
+ */
+static constexpr size_t NumThreads = 8;
+
+/**
+ * @brief Number of times the threads stem the whole list.
+ */
+static constexpr size_t NumRounds = 50;
+
+/**
+ * @brief Return the Porter stem of the given word.
+ *
+ * @param word Lowercase word to stem.
+ *
+ * @return Stem of the word.
+ */
+static std::string stem_of(std::string word) {
+    if (word.empty()) {
+        return word;
+    }
+    const int word_end = stem(&word[0], 0, static_cast<int>(word.size()) - 1);
+    word.resize(static_cast<size_t>(word_end) + 1);
+    return word;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " reference_list" << std::endl;
+        return -1;
+    }
+
+    std::ifstream ifs(argv[1]);
+    std::vector<std::string> words, stems;
+    std::string word, stemmed;
+    while (ifs >> word >> stemmed) {
+        words.push_back(word);
+        stems.push_back(stemmed);
+    }
+    if (words.empty()) {
+        std::cerr << "Cannot read reference list " << argv[1] << std::endl;
+        return -1;
+    }
+
+    size_t n_serial = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (stem_of(words[i]) != stems[i]) {
+            std::cerr << "serial: " << words[i] << " -> " << stem_of(words[i])
+                      << ", expected " << stems[i] << std::endl;
+            ++n_serial;
+        }
+    }
+
+    // small chunks interleave the words of different threads
+    std::atomic<size_t> n_concurrent{0};
+    ir::ThreadPool pool(NumThreads);
+    for (size_t round = 0; round < NumRounds; ++round) {
+        pool.parallel_for(words.size(), 16, [&](size_t beg, size_t end) {
+            for (size_t i = beg; i < end; ++i) {
+                if (stem_of(words[i]) != stems[i]) {
+                    ++n_concurrent;
+                }
+            }
+        });
+    }
+
+    std::cerr << words.size() << " words, " << n_serial
+              << " serial mismatches, " << n_concurrent.load()
+              << " concurrent mismatches in " << NumRounds << " rounds of "
+              << NumThreads << " threads" << std::endl;
+    return n_serial == 0 && n_concurrent.load() == 0 ? 0 : 1;
+}